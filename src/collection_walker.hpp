@@ -0,0 +1,308 @@
+#ifndef IRODS_ICOMMANDS_COLLECTION_WALKER_HPP
+#define IRODS_ICOMMANDS_COLLECTION_WALKER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace utils
+{
+    // Lists collections ahead of a consumer using a pool of connections.
+    //
+    // Every listed collection queues its sub-collections (down to the maximum depth) on the
+    // deque of the thread that listed it. Workers take the most recently queued collection
+    // from their own deque and steal the oldest one from another deque when theirs is empty,
+    // buffering the listings. The consumer takes listings in depth-first order, which keeps
+    // the output identical to a sequential walk. If the consumer needs a collection no worker
+    // has started yet, it lists the collection on its own connection rather than waiting.
+    //
+    // Connection is the type of the connections and Entry the type of a listed entry.
+    template <typename Connection, typename Entry>
+    class collection_walker
+    {
+      public:
+        using entry_visitor = std::function<void(const Entry&)>;
+
+        // Lists a collection over a connection, invoking the visitor for each entry.
+        using collection_lister = std::function<void(Connection&, const std::string&, const entry_visitor&)>;
+
+        // Returns the path of the sub-collection an entry refers to, if it refers to one.
+        using sub_collection_path = std::function<std::optional<std::string>(const Entry&)>;
+
+        // The roots are queued at depth 0. Sub-collections are queued while their depth is
+        // less than _max_depth.
+        collection_walker(Connection& _conn,
+                          std::vector<Connection>& _pool,
+                          const std::vector<std::string>& _roots,
+                          int _max_depth,
+                          collection_lister _list,
+                          sub_collection_path _sub_collection)
+            : conn_{_conn}
+            , max_depth_{_max_depth}
+            , list_{std::move(_list)}
+            , sub_collection_{std::move(_sub_collection)}
+            , queues_(_pool.size() + 1)
+        {
+            for (const auto& r : _roots) {
+                queue(r, 0, _pool.size());
+            }
+
+            workers_.reserve(_pool.size());
+
+            try {
+                for (std::size_t i = 0; i < _pool.size(); ++i) {
+                    workers_.emplace_back([this, &_pool, i] { work(_pool[i], i); });
+                }
+            }
+            catch (...) {
+                stop();
+                throw;
+            }
+        }
+
+        collection_walker(const collection_walker&) = delete;
+        auto operator=(const collection_walker&) -> collection_walker& = delete;
+
+        ~collection_walker()
+        {
+            stop();
+        }
+
+        // Returns the entries of the collection, waiting for a worker if one is already
+        // listing it. The error raised while listing the collection, if any, is rethrown.
+        auto take(const std::string& _path, int _depth) -> std::vector<Entry>
+        {
+            std::unique_lock lock{mutex_};
+            auto& l = listings_[_path];
+
+            if (listing_status::queued == l.status) {
+                l.status = listing_status::listing;
+                l.depth = _depth;
+                lock.unlock();
+                list(conn_, _path, queues_.size() - 1);
+                lock.lock();
+            }
+
+            cv_.wait(lock, [&l] { return listing_status::done == l.status; });
+
+            const auto error = l.error;
+            auto entries = std::move(l.entries);
+            buffered_entries_ -= entries.size();
+            listings_.erase(_path);
+            lock.unlock();
+            cv_.notify_all();
+
+            if (error) {
+                std::rethrow_exception(error);
+            }
+
+            return entries;
+        }
+
+        // Like take, but a collection no worker has started is streamed to the visitor as
+        // it is listed instead of being buffered. The visitor must not visit or take other
+        // collections, as the consumer's connection may still be in use.
+        auto visit(const std::string& _path, int _depth, const entry_visitor& _visit) -> void
+        {
+            std::unique_lock lock{mutex_};
+            auto& l = listings_[_path];
+
+            if (listing_status::queued == l.status) {
+                l.status = listing_status::listing;
+                l.depth = _depth;
+                lock.unlock();
+
+                try {
+                    list_(conn_, _path, [&](const Entry& _e) {
+                        if (_depth + 1 < max_depth_) {
+                            if (auto c = sub_collection_(_e)) {
+                                std::lock_guard lock{mutex_};
+                                queue(*c, _depth + 1, queues_.size() - 1);
+                                cv_.notify_one();
+                            }
+                        }
+                        _visit(_e);
+                    });
+                }
+                catch (...) {
+                    erase(_path);
+                    throw;
+                }
+
+                erase(_path);
+                return;
+            }
+
+            lock.unlock();
+
+            for (const auto& e : take(_path, _depth)) {
+                _visit(e);
+            }
+        }
+
+      private:
+        enum class listing_status
+        {
+            queued,
+            listing,
+            done
+        };
+
+        struct listing
+        {
+            listing_status status = listing_status::queued;
+            int depth = 0;
+            std::vector<Entry> entries;
+            std::exception_ptr error;
+        };
+
+        // Bounds the memory used by listings the consumer has not reached yet.
+        static constexpr std::size_t max_buffered_entries = 1 << 20;
+
+        auto stop() -> void
+        {
+            {
+                std::lock_guard lock{mutex_};
+                stopped_ = true;
+            }
+
+            cv_.notify_all();
+
+            for (auto& w : workers_) {
+                w.join();
+            }
+        }
+
+        auto erase(const std::string& _path) -> void
+        {
+            {
+                std::lock_guard lock{mutex_};
+                listings_.erase(_path);
+            }
+
+            cv_.notify_all();
+        }
+
+        // Requires the mutex to be held.
+        auto queue(const std::string& _path, int _depth, std::size_t _queue_index) -> void
+        {
+            listings_[_path].depth = _depth;
+            queues_[_queue_index].push_back(_path);
+        }
+
+        // Requires the mutex to be held.
+        auto next_collection(std::size_t _queue_index) -> std::optional<std::string>
+        {
+            for (std::size_t i = 0; i < queues_.size(); ++i) {
+                auto& q = queues_[(_queue_index + i) % queues_.size()];
+
+                while (!q.empty()) {
+                    // Take the newest entry from our own deque and the oldest from anyone else's.
+                    std::string path;
+
+                    if (0 == i) {
+                        path = std::move(q.back());
+                        q.pop_back();
+                    }
+                    else {
+                        path = std::move(q.front());
+                        q.pop_front();
+                    }
+
+                    // The consumer may have claimed (and even consumed) the collection already.
+                    auto it = listings_.find(path);
+
+                    if (it != std::end(listings_) && listing_status::queued == it->second.status) {
+                        it->second.status = listing_status::listing;
+                        return path;
+                    }
+                }
+            }
+
+            return std::nullopt;
+        }
+
+        auto work(Connection& _conn, std::size_t _queue_index) -> void
+        {
+            while (true) {
+                std::string path;
+
+                {
+                    std::unique_lock lock{mutex_};
+                    std::optional<std::string> next;
+
+                    cv_.wait(lock, [&] {
+                        return stopped_ ||
+                               (buffered_entries_ < max_buffered_entries && (next = next_collection(_queue_index)));
+                    });
+
+                    if (stopped_) {
+                        return;
+                    }
+
+                    path = std::move(*next);
+                }
+
+                list(_conn, path, _queue_index);
+            }
+        }
+
+        auto list(Connection& _conn, const std::string& _path, std::size_t _queue_index) -> void
+        {
+            std::vector<Entry> entries;
+            std::exception_ptr error;
+
+            try {
+                list_(_conn, _path, [&entries](const Entry& _e) { entries.push_back(_e); });
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+
+            {
+                std::lock_guard lock{mutex_};
+                auto& l = listings_[_path];
+
+                if (l.depth + 1 < max_depth_) {
+                    // Queued in reverse so that the first sub-collection is taken first.
+                    for (auto it = std::rbegin(entries); it != std::rend(entries); ++it) {
+                        if (auto c = sub_collection_(*it)) {
+                            queue(*c, l.depth + 1, _queue_index);
+                        }
+                    }
+                }
+
+                buffered_entries_ += entries.size();
+                l.entries = std::move(entries);
+                l.error = error;
+                l.status = listing_status::done;
+            }
+
+            cv_.notify_all();
+        }
+
+        Connection& conn_;
+        const int max_depth_;
+        const collection_lister list_;
+        const sub_collection_path sub_collection_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::unordered_map<std::string, listing> listings_;
+        // One deque per worker plus one, at the back, for collections listed by the consumer.
+        std::vector<std::deque<std::string>> queues_;
+        std::size_t buffered_entries_ = 0;
+        bool stopped_ = false;
+        std::vector<std::thread> workers_;
+    }; // class collection_walker
+} // namespace utils
+
+#endif // IRODS_ICOMMANDS_COLLECTION_WALKER_HPP
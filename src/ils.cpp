@@ -1,7 +1,10 @@
+#include "collection_walker.hpp"
 #include "utility.hpp"
 #include <irods/filesystem.hpp>
+#include <irods/irods_at_scope_exit.hpp>
 #include <irods/irods_buffer_encryption.hpp>
 #include <irods/irods_client_api_table.hpp>
+#include <irods/irods_exception.hpp>
 #include <irods/irods_pack_table.hpp>
 #include <irods/lsUtil.h>
 #include <irods/parseCommandLine.h>
@@ -10,13 +13,532 @@
 #include <irods/rodsPath.h>
 
 #include <fmt/core.h>
+#include <nlohmann/json.hpp>
 
 #include <cstdio>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <string>
+#include <variant>
+#include <vector>
 
 void usage();
 
+namespace
+{
+    namespace fs = irods::experimental::filesystem;
+
+    enum class output_format
+    {
+        text,
+        json,
+        ndjson,
+        csv
+    };
+
+    struct listing_options
+    {
+        bool long_format = false;
+        bool very_long_format = false;
+        bool recursive = false;
+        output_format format = output_format::text;
+    };
+
+    // A replica of a data object. Only the name is set for the short format.
+    struct replica_row
+    {
+        std::string name;
+        int replica_number = 0;
+        std::string owner;
+        std::string resource_hierarchy;
+        rodsLong_t size = 0;
+        std::string modify_time;
+        int status = 0;
+        std::string checksum;
+        std::string data_type;
+        std::string physical_path;
+    };
+
+    using data_object_callback = std::function<void(const replica_row&)>;
+    using collection_callback = std::function<void(const std::string&)>;
+    using row_callback = std::function<void(const std::vector<std::string>&)>;
+
+    struct gen_query_out_deleter
+    {
+        auto operator()(genQueryOut_t* _output) const -> void
+        {
+            freeGenQueryOut(&_output);
+        }
+    };
+
+    using gen_query_page = std::unique_ptr<genQueryOut_t, gen_query_out_deleter>;
+
+    // Runs a GenQuery, invoking _func for each row. The next page is requested on another
+    // thread while the rows of the current page are consumed, so formatting the output
+    // overlaps the round trip to the catalog. Only one thread uses the connection at a time.
+    auto for_each_row(rcComm_t* _comm, const std::string& _query, const row_callback& _func) -> void
+    {
+        genQueryInp_t input{};
+        irods::at_scope_exit clear_input{[&input] { clearGenQueryInp(&input); }};
+
+        std::string query = _query;
+
+        if (const auto ec = fillGenQueryInpFromStrCond(query.data(), &input); ec < 0) {
+            THROW(ec, fmt::format("Could not parse query [{}]", _query));
+        }
+
+        input.maxRows = MAX_SQL_ROWS;
+
+        const auto fetch_page = [_comm, &input]() -> gen_query_page {
+            genQueryOut_t* output{};
+            const auto ec = rcGenQuery(_comm, &input, &output);
+            gen_query_page page{output};
+
+            if (ec < 0) {
+                if (CAT_NO_ROWS_FOUND == ec) {
+                    return nullptr;
+                }
+
+                THROW(ec, "GenQuery failed");
+            }
+
+            return page;
+        };
+
+        std::future<gen_query_page> next_page;
+
+        // Releases the server-side statement when iteration stops before the last page.
+        irods::at_scope_exit close_query{[&] {
+            try {
+                if (next_page.valid()) {
+                    const auto page = next_page.get();
+                    input.continueInx = page ? page->continueInx : 0;
+                }
+
+                if (input.continueInx > 0) {
+                    input.maxRows = 0;
+                    genQueryOut_t* output{};
+                    rcGenQuery(_comm, &input, &output);
+                    freeGenQueryOut(&output);
+                }
+            }
+            catch (...) {
+            }
+        }};
+
+        std::vector<std::string> row;
+
+        for (auto page = fetch_page(); page;) {
+            input.continueInx = page->continueInx;
+
+            if (input.continueInx > 0) {
+                next_page = std::async(std::launch::async, fetch_page);
+            }
+
+            row.resize(page->attriCnt);
+
+            for (int i = 0; i < page->rowCnt; ++i) {
+                for (int j = 0; j < page->attriCnt; ++j) {
+                    const auto& column = page->sqlResult[j];
+                    row[j] = column.value + static_cast<std::ptrdiff_t>(i) * column.len;
+                }
+
+                _func(row);
+            }
+
+            page = next_page.valid() ? next_page.get() : nullptr;
+
+            if (!page) {
+                input.continueInx = 0;
+            }
+        }
+    } // for_each_row
+
+    // Lists the data objects matching _conditions, with one row per replica for the long
+    // formats. The leading columns are selected in the same order as lsUtil's queries, so
+    // GenQuery's default ordering on the selected columns sorts the rows the same way.
+    auto list_data_objects(rcComm_t* _comm,
+                           const std::string& _conditions,
+                           const listing_options& _opts,
+                           const data_object_callback& _on_data_object) -> void
+    {
+        if (_opts.long_format) {
+            const auto query = fmt::format("select DATA_NAME, DATA_ID, DATA_MODE, DATA_SIZE, DATA_MODIFY_TIME, "
+                                           "DATA_CREATE_TIME, DATA_OWNER_NAME, DATA_REPL_NUM, DATA_RESC_HIER, "
+                                           "DATA_REPL_STATUS, DATA_CHECKSUM, DATA_TYPE_NAME, DATA_PATH where {}",
+                                           _conditions);
+
+            for_each_row(_comm, query, [&_on_data_object](const auto& _row) {
+                replica_row r;
+                r.name = _row[0];
+                r.size = std::stoll(_row[3]);
+                r.modify_time = _row[4];
+                r.owner = _row[6];
+                r.replica_number = std::stoi(_row[7]);
+                r.resource_hierarchy = _row[8];
+                r.status = std::stoi(_row[9]);
+                r.checksum = _row[10];
+                r.data_type = _row[11];
+                r.physical_path = _row[12];
+                _on_data_object(r);
+            });
+        }
+        else {
+            const auto query = fmt::format("select DATA_NAME where {}", _conditions);
+
+            for_each_row(_comm, query, [&_on_data_object](const auto& _row) {
+                replica_row r;
+                r.name = _row[0];
+                _on_data_object(r);
+            });
+        }
+    } // list_data_objects
+
+    // Lists the data objects and then the sub-collections of a collection, each sorted by name.
+    // Like rclOpenCollection, the collection is stat'd first so that a collection the user
+    // cannot read is reported as an error instead of being listed as empty.
+    auto list_collection(rcComm_t* _comm,
+                         const std::string& _collection,
+                         const listing_options& _opts,
+                         const data_object_callback& _on_data_object,
+                         const collection_callback& _on_collection) -> void
+    {
+        dataObjInp_t input{};
+        rstrcpy(input.objPath, _collection.c_str(), MAX_NAME_LEN);
+
+        rodsObjStat_t* stat{};
+        const auto ec = rcObjStat(_comm, &input, &stat);
+        freeRodsObjStat(stat);
+
+        if (ec < 0) {
+            THROW(ec, fmt::format("Could not open collection [{}]", _collection));
+        }
+
+        list_data_objects(_comm, fmt::format("COLL_NAME = '{}'", _collection), _opts, _on_data_object);
+
+        const auto query = fmt::format("select COLL_NAME where COLL_PARENT_NAME = '{}'", _collection);
+
+        for_each_row(_comm, query, [&](const auto& _row) {
+            // The root collection is its own parent.
+            if (_row[0] != _collection) {
+                _on_collection(_row[0]);
+            }
+        });
+    } // list_collection
+
+    auto replica_status_char(int _status) -> char
+    {
+        switch (_status) {
+            case 0:  return 'X';
+            case 1:  return '&';
+            default: return '?';
+        }
+    } // replica_status_char
+
+    // Prints a data object in the same layout as lsUtil.
+    auto print_data_object(const replica_row& _r, const listing_options& _opts) -> void
+    {
+        if (!_opts.long_format) {
+            std::printf("  %s\n", _r.name.c_str());
+            return;
+        }
+
+        char local_time[TIME_LEN]{};
+        getLocalTimeFromRodsTime(_r.modify_time.c_str(), local_time);
+
+        std::printf("  %-12.12s %6d %-20.20s %12lld %16.16s %c %s\n",
+                    _r.owner.c_str(),
+                    _r.replica_number,
+                    _r.resource_hierarchy.c_str(),
+                    _r.size,
+                    local_time,
+                    replica_status_char(_r.status),
+                    _r.name.c_str());
+
+        if (_opts.very_long_format) {
+            std::printf("    %s    %s    %s\n", _r.checksum.c_str(), _r.data_type.c_str(), _r.physical_path.c_str());
+        }
+    } // print_data_object
+
+    // Streams replicas as JSON, NDJSON, or CSV records. Records are written as they arrive,
+    // so memory use does not grow with the size of the listing.
+    class record_writer
+    {
+      public:
+        explicit record_writer(output_format _format)
+            : format_{_format}
+        {
+            if (output_format::json == format_) {
+                std::fputs("[", stdout);
+            }
+            else if (output_format::csv == format_) {
+                std::fputs("collection,name,replica_number,owner,resource_hierarchy,size,modify_time,status,"
+                           "checksum,data_type,physical_path\n",
+                           stdout);
+            }
+        }
+
+        auto write(const std::string& _collection, const replica_row& _r) -> void
+        {
+            if (output_format::csv == format_) {
+                fmt::print("{},{},{},{},{},{},{},{},{},{},{}\n",
+                           csv_field(_collection),
+                           csv_field(_r.name),
+                           _r.replica_number,
+                           csv_field(_r.owner),
+                           csv_field(_r.resource_hierarchy),
+                           _r.size,
+                           modify_time(_r),
+                           _r.status,
+                           csv_field(_r.checksum),
+                           csv_field(_r.data_type),
+                           csv_field(_r.physical_path));
+                return;
+            }
+
+            const nlohmann::ordered_json record{{"collection", _collection},
+                                                {"name", _r.name},
+                                                {"replica_number", _r.replica_number},
+                                                {"owner", _r.owner},
+                                                {"resource_hierarchy", _r.resource_hierarchy},
+                                                {"size", _r.size},
+                                                {"modify_time", modify_time(_r)},
+                                                {"status", _r.status},
+                                                {"checksum", _r.checksum},
+                                                {"data_type", _r.data_type},
+                                                {"physical_path", _r.physical_path}};
+
+            // Invalid UTF-8 in a name must not abort a listing that is already half written.
+            const auto text = record.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+
+            if (output_format::json == format_) {
+                std::fputs(first_ ? "\n" : ",\n", stdout);
+                std::fputs(text.c_str(), stdout);
+            }
+            else {
+                std::puts(text.c_str());
+            }
+
+            first_ = false;
+        }
+
+        auto finish() -> void
+        {
+            if (output_format::json == format_) {
+                std::fputs(first_ ? "]\n" : "\n]\n", stdout);
+            }
+        }
+
+      private:
+        static auto modify_time(const replica_row& _r) -> long long
+        {
+            return _r.modify_time.empty() ? 0 : std::stoll(_r.modify_time);
+        }
+
+        static auto csv_field(const std::string& _value) -> std::string
+        {
+            if (_value.find_first_of(",\"\r\n") == std::string::npos) {
+                return _value;
+            }
+
+            std::string quoted = "\"";
+
+            for (char c : _value) {
+                if ('"' == c) {
+                    quoted += '"';
+                }
+                quoted += c;
+            }
+
+            return quoted += '"';
+        }
+
+        const output_format format_;
+        bool first_ = true;
+    }; // class record_writer
+
+    // A data object or a sub-collection listed by list_collection.
+    using collection_entry = std::variant<replica_row, std::string>;
+    using collection_walker = utils::collection_walker<rcComm_t*, collection_entry>;
+
+    // Prints a collection and, with -r, its sub-collections. A collection that cannot be
+    // listed is reported and skipped as lsUtil does, and the last error is returned.
+    auto print_collection(collection_walker& _walker,
+                          const std::string& _collection,
+                          int _depth,
+                          const listing_options& _opts,
+                          record_writer& _writer) -> int
+    {
+        const bool text = output_format::text == _opts.format;
+        bool header_printed = false;
+
+        // The header is held back until the collection has been opened.
+        const auto print_header = [&] {
+            if (text && !header_printed) {
+                std::printf("%s:\n", _collection.c_str());
+                header_printed = true;
+            }
+        };
+
+        std::vector<std::string> sub_collections;
+
+        try {
+            _walker.visit(_collection, _depth, [&](const collection_entry& _e) {
+                print_header();
+
+                if (const auto* r = std::get_if<replica_row>(&_e)) {
+                    if (text) {
+                        print_data_object(*r, _opts);
+                    }
+                    else {
+                        _writer.write(_collection, *r);
+                    }
+                    return;
+                }
+
+                const auto& c = std::get<std::string>(_e);
+
+                if (text) {
+                    std::printf("  C- %s\n", c.c_str());
+                }
+                if (_opts.recursive) {
+                    sub_collections.push_back(c);
+                }
+            });
+        }
+        catch (const irods::exception& e) {
+            rodsLogError(LOG_ERROR, e.code(), "print_collection: cannot list collection %s.", _collection.c_str());
+            return e.code();
+        }
+
+        print_header();
+
+        int status = 0;
+
+        for (const auto& c : sub_collections) {
+            if (const auto ec = print_collection(_walker, c, _depth + 1, _opts, _writer); ec < 0) {
+                status = ec;
+            }
+        }
+
+        return status;
+    } // print_collection
+
+    // Returns whether every path refers to a collection that can be listed with GenQuery.
+    auto only_collections(rcComm_t* _comm, rodsPathInp_t& _paths) -> bool
+    {
+        for (int i = 0; i < _paths.numSrc; ++i) {
+            auto& path = _paths.srcPath[i];
+
+            // Quotes cannot be escaped in GenQuery.
+            if (getRodsObjType(_comm, &path) < 0 || COLL_OBJ_T != path.objType || std::strchr(path.outPath, '\'')) {
+                return false;
+            }
+        }
+
+        return true;
+    } // only_collections
+
+    // Lists the paths in sorted order over _connections connections, one of which is _comm.
+    // Data object paths are only supported by the record formats.
+    auto list_paths(rcComm_t* _comm,
+                    rodsEnv& _env,
+                    rodsPathInp_t& _paths,
+                    const listing_options& _opts,
+                    int _connections) -> int
+    {
+        std::vector<rcComm_t*> pool;
+
+        irods::at_scope_exit disconnect_pool{[&pool] {
+            for (auto* comm : pool) {
+                rcDisconnect(comm);
+            }
+        }};
+
+        for (int i = 1; i < _connections; ++i) {
+            auto* comm = utils::connect_to_server(_env);
+
+            if (!comm) {
+                fmt::print(stderr, "Error: Could not open additional connection to the server.\n");
+                return SYS_INTERNAL_ERR;
+            }
+
+            pool.push_back(comm);
+        }
+
+        // Sub-collections are only prefetched for recursive listings.
+        collection_walker walker{
+            _comm,
+            pool,
+            {},
+            _opts.recursive ? std::numeric_limits<int>::max() : 1,
+            [&_opts](rcComm_t*& _conn, const std::string& _collection, const collection_walker::entry_visitor& _visit) {
+                list_collection(_conn, _collection, _opts, _visit, _visit);
+            },
+            [](const collection_entry& _e) -> std::optional<std::string> {
+                if (const auto* c = std::get_if<std::string>(&_e)) {
+                    return *c;
+                }
+                return std::nullopt;
+            }};
+        record_writer writer{_opts.format};
+        int status = 0;
+
+        for (int i = 0; i < _paths.numSrc; ++i) {
+            auto& path = _paths.srcPath[i];
+
+            if (std::strchr(path.outPath, '\'')) {
+                fmt::print(stderr, "Error: Paths containing single quotes are not supported: {}\n", path.outPath);
+                status = USER_INPUT_PATH_ERR;
+                continue;
+            }
+
+            if (getRodsObjType(_comm, &path) < 0 || NOT_EXIST_ST == path.objState) {
+                fmt::print(stderr, "Error: {} does not exist or user lacks access permission\n", path.outPath);
+                status = USER_INPUT_PATH_ERR;
+                continue;
+            }
+
+            if (COLL_OBJ_T == path.objType) {
+                if (const auto ec = print_collection(walker, path.outPath, 0, _opts, writer); ec < 0) {
+                    status = ec;
+                }
+                continue;
+            }
+
+            const fs::path object_path = path.outPath;
+            const auto collection = object_path.parent_path().string();
+            const auto conditions = fmt::format("COLL_NAME = '{}' and DATA_NAME = '{}'",
+                                                collection,
+                                                object_path.object_name().string());
+
+            list_data_objects(_comm, conditions, _opts, [&](const replica_row& _r) { writer.write(collection, _r); });
+        }
+
+        writer.finish();
+
+        return status;
+    } // list_paths
+
+    // Returns whether any of the given single-letter options appear on the command line.
+    auto short_option_given(const char* _options, int argc, char** argv) -> bool
+    {
+        for (int arg = 1; arg < argc; ++arg) {
+            if (argv[arg] && '-' == argv[arg][0] && '-' != argv[arg][1] && std::strpbrk(argv[arg] + 1, _options)) {
+                return true;
+            }
+        }
+
+        return false;
+    } // short_option_given
+} // anonymous namespace
+
 int
 main( int argc, char **argv ) {
 
@@ -30,6 +552,49 @@ main( int argc, char **argv ) {
     char *optStr;
     rodsPathInp_t rodsPathInp;
 
+    int connections = 1;
+    const auto parallel = utils::option_value("--parallel", argc, argv);
+
+    if (parallel) {
+        try {
+            connections = std::stoi(*parallel);
+        }
+        catch (const std::exception&) {
+            connections = 0;
+        }
+
+        if (connections < 1 || connections > utils::max_connections) {
+            printf( "Invalid number of connections for --parallel: expected 1 to %d\n", utils::max_connections );
+            exit( 1 );
+        }
+    }
+
+    // The listing engine does not support ACLs, listing collections themselves, or tickets.
+    const bool engine_supported = !short_option_given("Adt", argc, argv);
+
+    auto format = output_format::text;
+
+    if (const auto value = utils::option_value("--format", argc, argv); value) {
+        if ("json" == *value) {
+            format = output_format::json;
+        }
+        else if ("ndjson" == *value) {
+            format = output_format::ndjson;
+        }
+        else if ("csv" == *value) {
+            format = output_format::csv;
+        }
+        else {
+            printf( "Invalid value for --format: expected json, ndjson, or csv\n" );
+            exit( 1 );
+        }
+
+        if (!engine_supported) {
+            printf( "--format cannot be used with -A, -d, or -t\n" );
+            exit( 1 );
+        }
+    }
+
     // -=-=-=-=-=- JMC - backport 4536 -=-=-=-=-=-
     optStr = "hAdrlLvt:VZ";
     status = parseCmdLineOpt( argc, argv, optStr, 1, &myRodsArgs );
@@ -43,6 +608,10 @@ main( int argc, char **argv ) {
         usage();
         exit( 0 );
     }
+    if ( format != output_format::text && myRodsArgs.bundle == True ) {
+        printf( "--format cannot be used with --bundle\n" );
+        exit( 1 );
+    }
 
     status = getRodsEnv( &myEnv );
 
@@ -85,7 +654,23 @@ main( int argc, char **argv ) {
     }
 
     try {
-        status = lsUtil(conn, &myEnv, &myRodsArgs, &rodsPathInp);
+        listing_options opts;
+        opts.format = format;
+        // The record formats always carry every field.
+        opts.long_format =
+            myRodsArgs.longOption == True || myRodsArgs.veryLongOption == True || format != output_format::text;
+        opts.very_long_format = myRodsArgs.veryLongOption == True || format != output_format::text;
+        opts.recursive = myRodsArgs.recursive == True;
+
+        if (format != output_format::text) {
+            status = list_paths(conn, myEnv, rodsPathInp, opts, connections);
+        }
+        else if (parallel && engine_supported && myRodsArgs.bundle != True && only_collections(conn, rodsPathInp)) {
+            status = list_paths(conn, myEnv, rodsPathInp, opts, connections);
+        }
+        else {
+            status = lsUtil(conn, &myEnv, &myRodsArgs, &rodsPathInp);
+        }
     }
     catch (const irods::exception& e) {
         status = e.code();
@@ -120,6 +705,8 @@ usage() {
     char *msgs[] = {
         "Usage: ils [-ArlLv] dataObj|collection ... ",
         "Usage: ils --bundle [-r] dataObj|collection ... ",
+        "Usage: ils [-rlL] --parallel N collection ... ",
+        "Usage: ils [-r] [--parallel N] --format json|ndjson|csv dataObj|collection ... ",
         "Display data objects and collections stored in iRODS.",
         " ",
         "The following is typical output for ils with no arguments:",
@@ -195,6 +782,23 @@ usage() {
         " -h  this help",
         " --bundle - list the subfiles in the bundle file (usually stored in the",
         "     /myZone/bundle collection) created by iphybun command.",
+        " --parallel N - list collections with the prefetching listing engine over",
+        "     N connections, at most 64. The engine fetches the next page of each",
+        "     catalog query while the current one is printed, and with -r lists",
+        "     sub-collections ahead of the output over N-1 additional connections.",
+        "     Data objects and sub-collections are printed sorted by name, with each",
+        "     sub-collection's listing following that of its parent. The engine is",
+        "     opt-in: without --parallel or --format, ils lists collections one page",
+        "     at a time. Use --parallel 1 to list a single large collection with",
+        "     prefetching on one connection. Only applies when every argument is a",
+        "     collection and -A, -d, -t, and --bundle are not used.",
+        " --format json|ndjson|csv - stream one record per replica instead of the",
+        "     text listing. Records carry the collection, name, replica number,",
+        "     owner, resource hierarchy, size, modify time (seconds since the epoch),",
+        "     replica status, checksum, data type, and physical path. json writes a",
+        "     single array, ndjson one object per line, and csv a header line followed",
+        "     by one row per replica. Collections are descended with -r. Records",
+        "     are always listed with the engine described under --parallel.",
         ""
     };
     int i;
@@ -9,11 +9,1017 @@
 #include <irods/irods_client_api_table.hpp>
 #include <irods/irods_pack_table.hpp>
 #include <irods/irods_parse_command_line_options.hpp>
+#include <irods/irods_at_scope_exit.hpp>
+#include <irods/irods_query.hpp>
+#include <irods/checksum.h>
 
+#include <fmt/core.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 void usage( FILE* );
 
+namespace
+{
+    // A local file and the data object it is stored as.
+    struct put_task
+    {
+        std::string source;
+        std::string target;
+        rodsLong_t size = 0;
+        // The index of the command line source the file came from.
+        int source_index = 0;
+    };
+
+    // Bounds the number of files between the directory scan and the workers, so memory
+    // does not grow with the size of the tree.
+    constexpr std::size_t max_queued_files = 1 << 16;
+
+    // Files checked against the catalog per query by --dedupe. This keeps the checksum
+    // list within the length GenQuery accepts for a condition.
+    constexpr std::size_t dedupe_batch_size = 16;
+
+    // Files waiting to be uploaded by the workers.
+    class put_queue
+    {
+      public:
+        explicit put_queue(std::size_t _capacity)
+            : capacity_{_capacity}
+        {
+        }
+
+        // Blocks while the queue is full.
+        auto push(put_task _task) -> void
+        {
+            {
+                std::unique_lock lock{mutex_};
+                not_full_.wait(lock, [this] { return tasks_.size() < capacity_; });
+                tasks_.push_back(std::move(_task));
+            }
+
+            not_empty_.notify_one();
+        }
+
+        // Wakes the workers once the last file has been queued.
+        auto close() -> void
+        {
+            {
+                std::lock_guard lock{mutex_};
+                closed_ = true;
+            }
+
+            not_empty_.notify_all();
+        }
+
+        // Returns std::nullopt once the queue is closed and empty.
+        auto pop() -> std::optional<put_task>
+        {
+            std::unique_lock lock{mutex_};
+            not_empty_.wait(lock, [this] { return closed_ || !tasks_.empty(); });
+
+            if (tasks_.empty()) {
+                return std::nullopt;
+            }
+
+            auto task = std::move(tasks_.front());
+            tasks_.pop_front();
+            lock.unlock();
+            not_full_.notify_one();
+
+            return task;
+        }
+
+        // Returns up to _count tasks, waiting only for the first. Returns an empty vector
+        // once the queue is closed and empty.
+        auto pop_batch(std::size_t _count) -> std::vector<put_task>
+        {
+            std::unique_lock lock{mutex_};
+            not_empty_.wait(lock, [this] { return closed_ || !tasks_.empty(); });
+
+            std::vector<put_task> tasks;
+
+            while (!tasks_.empty() && tasks.size() < _count) {
+                tasks.push_back(std::move(tasks_.front()));
+                tasks_.pop_front();
+            }
+
+            lock.unlock();
+            not_full_.notify_all();
+
+            return tasks;
+        }
+
+      private:
+        const std::size_t capacity_;
+        std::mutex mutex_;
+        std::condition_variable not_empty_;
+        std::condition_variable not_full_;
+        std::deque<put_task> tasks_;
+        bool closed_ = false;
+    }; // class put_queue
+
+    // Chooses the number of transfer threads for large files from measured throughput,
+    // the bytes uploaded by all workers over the wall-clock time they took.
+    // Starting from 2, the count doubles while each step raises throughput by a margin.
+    // Once a step does not pay off, the count returns to the best one seen and holds there,
+    // probing a doubled or halved count now and then. Fewer threads are kept unless
+    // throughput drops by the margin, so the count backs off when the resource server
+    // is saturated rather than piling on streams that no longer help.
+    class thread_count_controller
+    {
+      public:
+        using clock = std::chrono::steady_clock;
+
+        thread_count_controller(int _max_threads, int _workers)
+            : max_threads_{std::max(_max_threads, 1)}
+            , samples_per_step_{std::max(min_samples_per_step, _workers)}
+            , threads_{std::min(2, max_threads_)}
+            , best_threads_{threads_}
+        {
+        }
+
+        auto threads() -> int
+        {
+            std::lock_guard lock{mutex_};
+            return threads_;
+        }
+
+        // Records the upload of _bytes between _start and _end using _threads threads.
+        auto record(int _threads,
+                    rodsLong_t _bytes,
+                    clock::time_point _start,
+                    clock::time_point _end,
+                    bool _verbose) -> void
+        {
+            std::lock_guard lock{mutex_};
+
+            // Uploads started before the last change say nothing about the current count.
+            if (_threads != threads_) {
+                return;
+            }
+
+            // Concurrent uploads overlap, so the samples are measured together over the
+            // span from the first start to the last end rather than summing their times.
+            if (0 == samples_) {
+                window_start_ = _start;
+                window_end_ = _end;
+            }
+            else {
+                window_start_ = std::min(window_start_, _start);
+                window_end_ = std::max(window_end_, _end);
+            }
+
+            bytes_ += _bytes;
+
+            if (++samples_ < samples_per_step_) {
+                return;
+            }
+
+            const std::chrono::duration<double> seconds = window_end_ - window_start_;
+            const auto bytes = bytes_;
+            bytes_ = 0;
+            samples_ = 0;
+
+            if (seconds.count() <= 0) {
+                return;
+            }
+
+            const auto throughput = static_cast<double>(bytes) / seconds.count();
+
+            step(throughput);
+
+            if (_verbose && threads_ != _threads) {
+                fmt::print("Adaptive threads: {:.1f} MB/s at {} threads, now using {} threads\n",
+                           throughput / 1e6,
+                           _threads,
+                           threads_);
+            }
+        }
+
+      private:
+        // Uploads measured at each count, smoothing out differences between files. At
+        // least one upload per worker is measured, so that the span covers them all.
+        static constexpr int min_samples_per_step = 3;
+
+        // Steps spent at the best count between probes.
+        static constexpr int hold_steps = 10;
+
+        // More threads must raise throughput by 5%; fewer may lower it by up to 5%.
+        static constexpr double margin = 1.05;
+
+        auto next_count(bool _up) const -> int
+        {
+            return std::clamp(_up ? threads_ * 2 : threads_ / 2, 1, max_threads_);
+        }
+
+        auto step(double _throughput) -> void
+        {
+            if (threads_ != best_threads_) {
+                const bool more = threads_ > best_threads_;
+                const bool better =
+                    more ? _throughput >= best_throughput_ * margin : _throughput >= best_throughput_ / margin;
+
+                if (better) {
+                    best_threads_ = threads_;
+                    best_throughput_ = _throughput;
+
+                    // Keep moving in the same direction while it pays off.
+                    if (const auto next = next_count(more); next != threads_) {
+                        threads_ = next;
+                    }
+                    else {
+                        hold_ = hold_steps;
+                    }
+
+                    return;
+                }
+
+                // Return to the best count and probe the other way next time.
+                threads_ = best_threads_;
+                hold_ = hold_steps;
+                probe_up_ = !more;
+
+                return;
+            }
+
+            // Conditions change, so the best count's throughput is refreshed each step.
+            best_throughput_ = _throughput;
+
+            if (hold_ > 0) {
+                --hold_;
+                return;
+            }
+
+            auto next = next_count(probe_up_);
+
+            if (next == threads_) {
+                probe_up_ = !probe_up_;
+                next = next_count(probe_up_);
+            }
+
+            if (next == threads_) {
+                hold_ = hold_steps;
+            }
+
+            threads_ = next;
+        }
+
+        const int max_threads_;
+        const int samples_per_step_;
+        std::mutex mutex_;
+        int threads_;
+        int best_threads_;
+        double best_throughput_ = 0;
+        bool probe_up_ = true;
+        int hold_ = 0;
+        rodsLong_t bytes_ = 0;
+        clock::time_point window_start_;
+        clock::time_point window_end_;
+        int samples_ = 0;
+    }; // class thread_count_controller
+
+    // Removes an option the iRODS option parser does not know about from the command line,
+    // returning its value. Accepts "--option VALUE" and "--option=VALUE".
+    auto take_option_value(std::string_view _option, int& argc, char** argv) -> std::optional<std::string>
+    {
+        for (int arg = 1; arg < argc; ++arg) {
+            const std::string_view current = argv[arg];
+            std::optional<std::string> value;
+            int count = 1;
+
+            if (_option == current) {
+                value = arg + 1 < argc ? argv[arg + 1] : "";
+                count = arg + 1 < argc ? 2 : 1;
+            }
+            else if (current.size() > _option.size() && current.starts_with(_option) &&
+                     '=' == current[_option.size()])
+            {
+                value = std::string{current.substr(_option.size() + 1)};
+            }
+            else {
+                continue;
+            }
+
+            std::copy(argv + arg + count, argv + argc + 1, argv + arg);
+            argc -= count;
+
+            return value;
+        }
+
+        return std::nullopt;
+    } // take_option_value
+
+    // Removes a flag the iRODS option parser does not know about from the command line,
+    // returning whether it was given.
+    auto take_flag(std::string_view _flag, int& argc, char** argv) -> bool
+    {
+        const auto it = std::find_if(argv + 1, argv + argc, [_flag](const char* _arg) { return _flag == _arg; });
+
+        if (it == argv + argc) {
+            return false;
+        }
+
+        std::copy(it + 1, argv + argc + 1, it);
+        --argc;
+
+        return true;
+    } // take_flag
+
+    // Returns whether an option is on the command line, as "--option" or "--option=VALUE".
+    auto option_present(std::string_view _option, int argc, char** argv) -> bool
+    {
+        return std::any_of(argv + 1, argv + argc, [_option](std::string_view _arg) {
+            return _option == _arg ||
+                   (_arg.size() > _option.size() && _arg.starts_with(_option) && '=' == _arg[_option.size()]);
+        });
+    } // option_present
+
+    auto create_collection(rcComm_t* _comm, const std::string& _path) -> int
+    {
+        collInp_t input{};
+        std::snprintf(input.collName, sizeof(input.collName), "%s", _path.c_str());
+        addKeyVal(&input.condInput, RECURSIVE_OPR__KW, "");
+
+        const auto ec = rcCollCreate(_comm, &input);
+        clearKeyVal(&input.condInput);
+
+        return ec;
+    } // create_collection
+
+    // Returns the checksum of a local file in the same form as the catalog, or an empty
+    // string on error.
+    auto local_checksum(const std::string& _path, const char* _hash_scheme) -> std::string
+    {
+        char checksum[NAME_LEN]{};
+
+        if (const auto ec = chksumLocFile(_path.c_str(), checksum, _hash_scheme); ec < 0) {
+            rodsLogError(LOG_ERROR, ec, "local_checksum: cannot checksum %s", _path.c_str());
+            return {};
+        }
+
+        return checksum;
+    } // local_checksum
+
+    // Looks up data objects with the same content as each file, by checksum and size, under
+    // the collection its command line source is uploaded to (_scopes[task.source_index]). Returns,
+    // per file, the logical path of an identical good replica; the file's own target path
+    // when the data object is already up to date; or an empty string when there is no match.
+    // _checksums holds the checksum of each file, empty where it could not be computed.
+    auto find_duplicates(rcComm_t* _comm,
+                         const std::vector<put_task>& _tasks,
+                         const std::vector<std::string>& _checksums,
+                         const std::vector<std::string>& _scopes) -> std::vector<std::string>
+    {
+        const auto& checksums = _checksums;
+        std::vector<std::string> duplicates(_tasks.size());
+        std::vector<bool> queried(_tasks.size());
+
+        // One query per command line source in the batch, which is nearly always just one.
+        for (std::size_t i = 0; i < _tasks.size(); ++i) {
+            const auto& scope = _scopes[_tasks[i].source_index];
+
+            if (queried[i] || scope.find('\'') != std::string::npos) {
+                continue;
+            }
+
+            std::string in_list;
+
+            for (std::size_t j = i; j < _tasks.size(); ++j) {
+                if (_tasks[j].source_index == _tasks[i].source_index && !checksums[j].empty()) {
+                    in_list += fmt::format("{}'{}'", in_list.empty() ? "" : ", ", checksums[j]);
+                }
+            }
+
+            if (in_list.empty()) {
+                continue;
+            }
+
+            // Logical paths of good replicas, keyed by checksum and size.
+            std::unordered_map<std::string, std::vector<std::string>> matches;
+
+            try {
+                const auto query_string = fmt::format("select DATA_CHECKSUM, DATA_SIZE, COLL_NAME, DATA_NAME where "
+                                                      "DATA_CHECKSUM in ({}) and DATA_REPL_STATUS = '1' and "
+                                                      "COLL_NAME = '{}' || like '{}/%'",
+                                                      in_list,
+                                                      scope,
+                                                      scope);
+
+                for (auto&& row : irods::query<rcComm_t>{_comm, query_string}) {
+                    matches[row[0] + ':' + row[1]].push_back(row[2] + '/' + row[3]);
+                }
+            }
+            catch (const irods::exception& e) {
+                rodsLogError(LOG_ERROR, e.code(), "find_duplicates: catalog query failed");
+            }
+
+            for (std::size_t j = i; j < _tasks.size(); ++j) {
+                if (_tasks[j].source_index != _tasks[i].source_index) {
+                    continue;
+                }
+
+                queried[j] = true;
+
+                const auto it = matches.find(fmt::format("{}:{}", checksums[j], _tasks[j].size));
+
+                if (checksums[j].empty() || it == std::end(matches)) {
+                    continue;
+                }
+
+                const auto& paths = it->second;
+                const bool up_to_date =
+                    std::find(std::begin(paths), std::end(paths), _tasks[j].target) != std::end(paths);
+                duplicates[j] = up_to_date ? _tasks[j].target : paths.front();
+            }
+        }
+
+        return duplicates;
+    } // find_duplicates
+
+    // Compares a checksum computed by the client with the checksums the server registered
+    // for the good replicas of a data object while it was put. Replicas whose checksum uses
+    // another hash scheme than the client's cannot be compared and are skipped with a warning.
+    auto verify_catalog_checksum(rcComm_t* _comm, const std::string& _path, const std::string& _checksum) -> int
+    {
+        // MD5 checksums have no prefix. The others are prefixed with the scheme, e.g. "sha2:".
+        const auto scheme = [](const std::string& _c) { return _c.substr(0, _c.find(':') + 1); };
+
+        const auto separator = _path.rfind('/');
+        const auto query_string = fmt::format(
+            "select DATA_CHECKSUM where COLL_NAME = '{}' and DATA_NAME = '{}' and DATA_REPL_STATUS = '1'",
+            _path.substr(0, separator),
+            _path.substr(separator + 1));
+
+        std::vector<std::string> checksums;
+
+        try {
+            for (auto&& row : irods::query<rcComm_t>{_comm, query_string}) {
+                checksums.push_back(row[0]);
+            }
+        }
+        catch (const irods::exception& e) {
+            rodsLogError(LOG_ERROR, e.code(), "verify_catalog_checksum: catalog query failed for %s", _path.c_str());
+            return e.code();
+        }
+
+        if (checksums.empty()) {
+            rodsLog(LOG_ERROR, "verify_catalog_checksum: no good replica of %s", _path.c_str());
+            return USER_CHKSUM_MISMATCH;
+        }
+
+        for (const auto& c : checksums) {
+            if (c.empty()) {
+                rodsLog(LOG_ERROR,
+                        "verify_catalog_checksum: the server did not register a checksum for %s",
+                        _path.c_str());
+                return USER_CHKSUM_MISMATCH;
+            }
+
+            if (scheme(c) != scheme(_checksum)) {
+                rodsLog(LOG_WARNING,
+                        "verify_catalog_checksum: %s has a checksum in another hash scheme [%s]. Not verified.",
+                        _path.c_str(),
+                        c.c_str());
+                continue;
+            }
+
+            if (c != _checksum) {
+                rodsLog(LOG_ERROR,
+                        "verify_catalog_checksum: checksum mismatch for %s [client=%s, catalog=%s]",
+                        _path.c_str(),
+                        _checksum.c_str(),
+                        c.c_str());
+                return USER_CHKSUM_MISMATCH;
+            }
+        }
+
+        return 0;
+    } // verify_catalog_checksum
+
+    // Copies a data object on the server, so its contents are not sent by the client. The
+    // target resource, -f, -k, and -K apply to the copy as they would to the upload.
+    auto copy_data_object(rcComm_t* _comm,
+                          const std::string& _source,
+                          const std::string& _target,
+                          const dataObjInp_t& _put_input,
+                          const rodsArguments_t& _args) -> int
+    {
+        dataObjCopyInp_t input{};
+        irods::at_scope_exit clear_input{[&input] { clearKeyVal(&input.destDataObjInp.condInput); }};
+
+        std::snprintf(input.srcDataObjInp.objPath, sizeof(input.srcDataObjInp.objPath), "%s", _source.c_str());
+        std::snprintf(input.destDataObjInp.objPath, sizeof(input.destDataObjInp.objPath), "%s", _target.c_str());
+        input.srcDataObjInp.oprType = COPY_SRC;
+        input.destDataObjInp.oprType = COPY_DEST;
+
+        if (const char* resource = getValByKey(&_put_input.condInput, DEST_RESC_NAME_KW); resource) {
+            addKeyVal(&input.destDataObjInp.condInput, DEST_RESC_NAME_KW, resource);
+        }
+
+        if (_args.force == True) {
+            addKeyVal(&input.destDataObjInp.condInput, FORCE_FLAG_KW, "");
+        }
+
+        if (_args.checksum == True) {
+            addKeyVal(&input.destDataObjInp.condInput, REG_CHKSUM_KW, "");
+        }
+
+        if (_args.verifyChecksum == True) {
+            addKeyVal(&input.destDataObjInp.condInput, VERIFY_CHKSUM_KW, "");
+        }
+
+        return rcDataObjCopy(_comm, &input);
+    } // copy_data_object
+
+    // Uploads files from the queue until it is drained, returning the last error. When
+    // _threads is set, it picks the thread count for files large enough for parallel transfer.
+    // When _dedupe_scopes is set, files already in the catalog are skipped or copied there.
+    auto put_files(rcComm_t* _comm,
+                   rodsEnv& _env,
+                   rodsArguments_t& _args,
+                   put_queue& _queue,
+                   thread_count_controller* _threads,
+                   const std::vector<std::string>* _dedupe_scopes) -> int
+    {
+        dataObjInp_t input{};
+        bulkOprInp_t bulk_input{};
+        rodsRestart_t restart{};
+        irods::at_scope_exit clear_input{[&input] { clearKeyVal(&input.condInput); }};
+
+        int status = initCondForPut(_comm, &_env, &_args, &input, &bulk_input, &restart);
+
+        if (status < 0) {
+            rodsLogError(LOG_ERROR, status, "put_files: initCondForPut error");
+
+            // Keep draining so that the producer never waits on a dead worker.
+            while (_queue.pop()) {
+            }
+
+            return status;
+        }
+
+        const auto default_threads = input.numThreads;
+        const bool verify_checksum = _args.verifyChecksum == True;
+        const bool register_checksum = _args.checksum == True;
+
+        // putFileUtil reads the whole file to checksum it before sending it when -K is given.
+        // Instead, either a checksum computed ahead of time is passed to it with VERIFY_CHKSUM_KW,
+        // or the server is asked to compute and register the checksum with REG_CHKSUM_KW, using
+        // arguments that do not ask for a client-side checksum again. With -k, the server
+        // computes the checksum anyway, so one already computed by --dedupe is verified too.
+        rodsArguments_t precomputed_args = _args;
+        precomputed_args.checksum = False;
+        precomputed_args.verifyChecksum = False;
+
+        // Returns the error of the put, which is also recorded in status.
+        const auto transfer = [&](put_task& _task, rodsArguments_t* _put_args) {
+            const bool adaptive = _threads && _task.size >= MIN_SZ_FOR_PAR_XFER;
+            const auto threads = adaptive ? _threads->threads() : default_threads;
+            input.numThreads = threads;
+
+            const auto start = std::chrono::steady_clock::now();
+            const auto ec = putFileUtil(_comm, _task.source.data(), _task.target.data(), _task.size, _put_args, &input);
+
+            if (ec < 0) {
+                rodsLogError(LOG_ERROR, ec, "put_files: put %s failed.", _task.source.c_str());
+                status = ec;
+            }
+            else if (adaptive) {
+                _threads->record(threads, _task.size, start, std::chrono::steady_clock::now(), _args.verbose == True);
+            }
+
+            return ec;
+        };
+
+        // _checksum is the precomputed checksum of the file, if any.
+        const auto put = [&](put_task& _task, const std::string& _checksum) {
+            auto* args = &_args;
+
+            if ((register_checksum || verify_checksum) && !_checksum.empty()) {
+                addKeyVal(&input.condInput, VERIFY_CHKSUM_KW, _checksum.c_str());
+                args = &precomputed_args;
+            }
+
+            transfer(_task, args);
+
+            // The input is shared by every file, so the checksum must not reach the next one.
+            rmKeyVal(&input.condInput, VERIFY_CHKSUM_KW);
+        };
+
+        const auto checksum = [&_env](const std::string& _path) {
+            return local_checksum(_path, _env.rodsDefaultHashScheme);
+        };
+
+        // With -K, the file is checksummed on another thread while it is sent, so both read
+        // it in the same pass through the page cache. The server registers the checksum of
+        // the replica it writes, which is compared with the client's once the put completes.
+        const auto put_and_verify = [&](put_task& _task) {
+            // Quotes cannot be escaped in GenQuery, so the catalog checksum cannot be looked up.
+            if (_task.target.find('\'') != std::string::npos) {
+                put(_task, {});
+                return;
+            }
+
+            auto client_checksum = std::async(std::launch::async, checksum, _task.source);
+
+            rmKeyVal(&input.condInput, VERIFY_CHKSUM_KW);
+            addKeyVal(&input.condInput, REG_CHKSUM_KW, "");
+
+            const auto ec = transfer(_task, &precomputed_args);
+
+            if (!register_checksum) {
+                rmKeyVal(&input.condInput, REG_CHKSUM_KW);
+            }
+
+            const auto expected = client_checksum.get();
+
+            if (ec < 0) {
+                return;
+            }
+
+            if (expected.empty()) {
+                rodsLog(LOG_ERROR, "put_files: cannot verify %s.", _task.target.c_str());
+                status = USER_CHKSUM_MISMATCH;
+            }
+            else if (const auto verify_ec = verify_catalog_checksum(_comm, _task.target, expected); verify_ec < 0) {
+                status = verify_ec;
+            }
+        };
+
+        if (!_dedupe_scopes) {
+            while (auto task = _queue.pop()) {
+                if (verify_checksum) {
+                    put_and_verify(*task);
+                }
+                else {
+                    put(*task, {});
+                }
+            }
+
+            return status;
+        }
+
+        while (true) {
+            auto tasks = _queue.pop_batch(dedupe_batch_size);
+
+            if (tasks.empty()) {
+                break;
+            }
+
+            // With -k or -K, the checksums are also passed to the uploads.
+            std::vector<std::string> checksums;
+            checksums.reserve(tasks.size());
+
+            for (const auto& task : tasks) {
+                checksums.push_back(checksum(task.source));
+            }
+
+            const auto duplicates = find_duplicates(_comm, tasks, checksums, *_dedupe_scopes);
+
+            for (std::size_t i = 0; i < tasks.size(); ++i) {
+                const auto& task = tasks[i];
+                const auto& duplicate = duplicates[i];
+
+                if (duplicate.empty()) {
+                    put(tasks[i], checksums[i]);
+                }
+                else if (duplicate == task.target) {
+                    if (_args.verbose == True) {
+                        fmt::print("Unchanged: {}\n", task.target);
+                    }
+                }
+                else if (const auto ec = copy_data_object(_comm, duplicate, task.target, input, _args); ec < 0) {
+                    rodsLogError(
+                        LOG_ERROR, ec, "put_files: copy %s to %s failed.", duplicate.c_str(), task.target.c_str());
+                    status = ec;
+                }
+                else if (_args.verbose == True) {
+                    fmt::print("Copied in the catalog: {} -> {}\n", duplicate, task.target);
+                }
+            }
+        }
+
+        return status;
+    } // put_files
+
+    // Walks local directory trees, creating a collection for each directory and queueing
+    // files as their entries are read. Entries are read in large batches with getdents64(2)
+    // and typed from d_type, so only regular files (for their size), symbolic links, and
+    // entries of unknown type are stat'ed, relative to the open directory. Directories are
+    // walked depth first from an explicit stack and closed before their sub-directories
+    // are read, so one descriptor is open at a time and deep trees do not recurse.
+    class directory_scanner
+    {
+      public:
+        directory_scanner(rcComm_t* _comm, bool _ignore_symlinks, put_queue& _queue)
+            : comm_{_comm}
+            , ignore_symlinks_{_ignore_symlinks}
+            , queue_{_queue}
+            , buffer_{std::make_unique<char[]>(buffer_size)}
+        {
+        }
+
+        // Scans the directory given as command line source _index.
+        auto scan(const std::string& _source, const std::string& _target, int _index) -> int
+        {
+            source_index_ = _index;
+
+            // Directories waiting to be read. Sub-directories are pushed as they are found,
+            // so the stack holds the unread siblings of the directories on the current path.
+            std::vector<pending_directory> stack{{_source, _target, 0}};
+            std::vector<directory_id> ancestors;
+            int status = 0;
+
+            while (!stack.empty()) {
+                const auto d = std::move(stack.back());
+                stack.pop_back();
+
+                // Only the directories above this one are its ancestors.
+                ancestors.resize(d.depth);
+
+                const auto first_sub_directory = stack.size();
+
+                if (const auto ec = read_directory(d.source, d.target, d.depth, ancestors, stack); ec < 0) {
+                    status = ec;
+                }
+
+                // Reversed so that sub-directories are scanned in the order they were read.
+                std::reverse(std::begin(stack) + first_sub_directory, std::end(stack));
+            }
+
+            return status;
+        }
+
+      private:
+        static constexpr std::size_t buffer_size = 256 * 1024;
+
+        using directory_id = std::pair<dev_t, ino_t>;
+
+        struct pending_directory
+        {
+            std::string source;
+            std::string target;
+            // The number of directories between this one and the scanned source.
+            std::size_t depth = 0;
+        };
+
+        // Creates the collection for a directory, queues its files, and pushes its
+        // sub-directories onto _stack. The directory is added to _ancestors once opened.
+        auto read_directory(const std::string& _source,
+                            const std::string& _target,
+                            std::size_t _depth,
+                            std::vector<directory_id>& _ancestors,
+                            std::vector<pending_directory>& _stack) -> int
+        {
+            const int fd = open(_source.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+            if (fd < 0) {
+                const auto ec = UNIX_FILE_OPENDIR_ERR - errno;
+                rodsLogError(LOG_ERROR, ec, "directory_scanner: cannot open directory %s", _source.c_str());
+                return ec;
+            }
+
+            irods::at_scope_exit close_fd{[fd] { close(fd); }};
+
+            struct stat st{};
+
+            if (fstat(fd, &st) < 0) {
+                const auto ec = UNIX_FILE_STAT_ERR - errno;
+                rodsLogError(LOG_ERROR, ec, "directory_scanner: cannot stat directory %s", _source.c_str());
+                return ec;
+            }
+
+            // Symbolic links may lead back to a directory being scanned. Such a loop is
+            // skipped without failing the upload, as putUtil does.
+            const directory_id id{st.st_dev, st.st_ino};
+
+            if (std::find(std::begin(_ancestors), std::end(_ancestors), id) != std::end(_ancestors)) {
+                rodsLog(LOG_ERROR,
+                        "directory_scanner: skipping %s, which links to one of its parent directories",
+                        _source.c_str());
+                return 0;
+            }
+
+            _ancestors.push_back(id);
+
+            if (const auto ec = create_collection(comm_, _target); ec < 0) {
+                rodsLogError(LOG_ERROR, ec, "directory_scanner: cannot create collection %s", _target.c_str());
+                return ec;
+            }
+
+            int status = 0;
+
+            while (true) {
+                const auto bytes_read = syscall(SYS_getdents64, fd, buffer_.get(), buffer_size);
+
+                if (bytes_read < 0) {
+                    const auto ec = UNIX_FILE_READDIR_ERR - errno;
+                    rodsLogError(LOG_ERROR, ec, "directory_scanner: cannot read directory %s", _source.c_str());
+                    return ec;
+                }
+
+                if (0 == bytes_read) {
+                    return status;
+                }
+
+                for (long offset = 0; offset < bytes_read;) {
+                    const auto* entry = reinterpret_cast<const dirent64*>(buffer_.get() + offset);
+                    offset += entry->d_reclen;
+
+                    const std::string_view name = entry->d_name;
+
+                    if ("." == name || ".." == name || (DT_LNK == entry->d_type && ignore_symlinks_)) {
+                        continue;
+                    }
+
+                    auto type = entry->d_type;
+                    rodsLong_t size = 0;
+
+                    if (DT_REG == type || DT_LNK == type || DT_UNKNOWN == type) {
+                        struct stat st{};
+
+                        // Symbolic links are followed unless --ignore-symlinks is given, as in putUtil.
+                        if (fstatat(fd, entry->d_name, &st, ignore_symlinks_ ? AT_SYMLINK_NOFOLLOW : 0) < 0) {
+                            status = UNIX_FILE_STAT_ERR - errno;
+                            rodsLogError(LOG_ERROR,
+                                         status,
+                                         "directory_scanner: cannot stat %s/%s",
+                                         _source.c_str(),
+                                         entry->d_name);
+                            continue;
+                        }
+
+                        type = S_ISDIR(st.st_mode) ? DT_DIR : (S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN);
+                        size = st.st_size;
+                    }
+
+                    if (DT_DIR == type) {
+                        _stack.push_back({_source + '/' + entry->d_name,
+                                          _target + '/' + entry->d_name,
+                                          _depth + 1});
+                    }
+                    else if (DT_REG == type) {
+                        queue_.push(
+                            {_source + '/' + entry->d_name, _target + '/' + entry->d_name, size, source_index_});
+                    }
+                }
+            }
+        }
+
+        rcComm_t* comm_;
+        const bool ignore_symlinks_;
+        put_queue& queue_;
+        std::unique_ptr<char[]> buffer_;
+        int source_index_ = 0;
+    }; // class directory_scanner
+
+    // Uploads the sources on _workers connections, each taking files from a shared queue.
+    // The main thread scans directories on the main connection, creating collections and
+    // queueing files while the workers upload.
+    auto put_concurrently(rcComm_t* _comm,
+                          rodsEnv& _env,
+                          rodsArguments_t& _args,
+                          rodsPathInp_t& _paths,
+                          int _workers,
+                          int _reconnect_flag,
+                          bool _ignore_symlinks,
+                          bool _adaptive_threads,
+                          bool _dedupe) -> int
+    {
+        if (const auto ec = resolveRodsTarget(_comm, &_paths, PUT_OPR); ec < 0) {
+            rodsLogError(LOG_ERROR, ec, "put_concurrently: resolveRodsTarget error");
+            return ec;
+        }
+
+        std::vector<rcComm_t*> pool;
+
+        irods::at_scope_exit disconnect_pool{[&pool] {
+            for (auto* comm : pool) {
+                printErrorStack(comm->rError);
+                rcDisconnect(comm);
+            }
+        }};
+
+        for (int i = 0; i < _workers; ++i) {
+            auto* comm = utils::connect_to_server(_env, _reconnect_flag);
+
+            if (!comm) {
+                fmt::print(stderr, "Error: Could not open connection for worker {}.\n", i + 1);
+                return SYS_INTERNAL_ERR;
+            }
+
+            pool.push_back(comm);
+        }
+
+        put_queue queue{max_queued_files};
+
+        // -N sets the upper bound for the adaptive thread count. -N 0 is rejected by main.
+        const auto max_threads = _args.number == True ? _args.numberValue : MAX_NUM_CONFIG_TRAN_THR;
+        std::optional<thread_count_controller> threads;
+
+        if (_adaptive_threads) {
+            threads.emplace(max_threads, _workers);
+        }
+
+        // The collection each source is uploaded to, which --dedupe searches for duplicates.
+        std::vector<std::string> scopes(_paths.numSrc);
+
+        for (int i = 0; i < _paths.numSrc; ++i) {
+            const std::string target = _paths.targPath[i].outPath;
+            scopes[i] = LOCAL_DIR_T == _paths.srcPath[i].objType ? target : target.substr(0, target.rfind('/'));
+        }
+
+        std::vector<int> worker_status(pool.size());
+        std::vector<std::thread> workers;
+        workers.reserve(pool.size());
+
+        // Stops the workers if scanning throws, so no thread is left running or unjoined.
+        irods::at_scope_exit join_workers{[&queue, &workers] {
+            queue.close();
+
+            for (auto& w : workers) {
+                if (w.joinable()) {
+                    w.join();
+                }
+            }
+        }};
+
+        auto* controller = threads ? &*threads : nullptr;
+        const auto* dedupe_scopes = _dedupe ? &scopes : nullptr;
+
+        for (std::size_t i = 0; i < pool.size(); ++i) {
+            workers.emplace_back([&, i] {
+                worker_status[i] = put_files(pool[i], _env, _args, queue, controller, dedupe_scopes);
+            });
+        }
+
+        directory_scanner scanner{_comm, _ignore_symlinks, queue};
+        int status = 0;
+
+        for (int i = 0; i < _paths.numSrc; ++i) {
+            const auto& source = _paths.srcPath[i];
+            const auto& target = _paths.targPath[i];
+
+            if (LOCAL_FILE_T == source.objType) {
+                queue.push({source.outPath, target.outPath, source.size, i});
+            }
+            else if (LOCAL_DIR_T == source.objType) {
+                if (_args.recursive != True) {
+                    rodsLog(LOG_ERROR,
+                            "put_concurrently: input path %s is not a file, use -r to upload directories",
+                            source.outPath);
+                    status = USER_INPUT_OPTION_ERR;
+                    continue;
+                }
+
+                if (const auto ec = scanner.scan(source.outPath, target.outPath, i); ec < 0) {
+                    status = ec;
+                }
+            }
+            else {
+                rodsLog(LOG_ERROR, "put_concurrently: invalid put source %s", source.outPath);
+                status = USER_INPUT_PATH_ERR;
+            }
+        }
+
+        queue.close();
+
+        for (auto& w : workers) {
+            w.join();
+        }
+
+        for (const auto ec : worker_status) {
+            if (ec < 0) {
+                status = ec;
+            }
+        }
+
+        return status;
+    } // put_concurrently
+} // anonymous namespace
+
 int
 main( int argc, char **argv ) {
     set_ips_display_name("iput");
@@ -31,6 +1037,32 @@ main( int argc, char **argv ) {
         return status;
     }
 
+    int workers = 0;
+    if ( const auto value = take_option_value( "--workers", argc, argv ); value ) {
+        try {
+            workers = std::stoi( *value );
+        }
+        catch ( const std::exception& ) {
+            workers = 0;
+        }
+
+        if ( workers < 1 || workers > utils::max_connections ) {
+            fprintf( stderr, "Error: Invalid number of workers for --workers: expected 1 to %d.\n",
+                     utils::max_connections );
+            return EXIT_FAILURE;
+        }
+    }
+    const bool ignore_symlinks = option_present( "--ignore-symlinks", argc, argv );
+
+    // Adaptive thread counts are chosen per file by the --workers engine.
+    const bool adaptive_threads = take_flag( "--adaptive-threads", argc, argv );
+
+    // Duplicates are looked up per batch of files by the --workers engine.
+    const bool dedupe = take_flag( "--dedupe", argc, argv );
+    if ( ( adaptive_threads || dedupe ) && workers == 0 ) {
+        workers = 1;
+    }
+
     rodsPathInp_t rodsPathInp{};
     const auto free_rodsPathInp = irods::at_scope_exit{[&rodsPathInp] { freeRodsPathInpMembers(&rodsPathInp); }};
     int p_err = parse_opts_and_paths(
@@ -62,6 +1094,36 @@ main( int argc, char **argv ) {
         return EXIT_SUCCESS;
     }
 
+    const bool engine_supported = !( myRodsArgs.bulk == True || myRodsArgs.redirectConn == True ||
+                                     myRodsArgs.progressFlag == True || myRodsArgs.restart == True ||
+                                     myRodsArgs.lfrestart == True || myRodsArgs.retries == True );
+
+    // The --workers engine checksums a file for -K while it is sent, so -K implies
+    // --workers 1 when the other options allow it. Otherwise putUtil reads the whole
+    // file to checksum it before sending it.
+    if ( myRodsArgs.verifyChecksum == True && workers == 0 && engine_supported ) {
+        workers = 1;
+    }
+
+    if ( workers > 0 && !engine_supported ) {
+        fprintf( stderr, "Error: --workers cannot be used with -b, -I, -P, -X, --lfrestart, or --retries.\n" );
+        return EXIT_FAILURE;
+    }
+
+    // Skipped files and server-side copies do not go through the put, so the options
+    // that only the put applies cannot be honored for them.
+    if ( dedupe && ( myRodsArgs.dataType == True || option_present( "--metadata", argc, argv ) ||
+                     option_present( "--acl", argc, argv ) || option_present( "--kv_pass", argc, argv ) ) ) {
+        fprintf( stderr, "Error: --dedupe cannot be used with -D, --metadata, --acl, or --kv_pass.\n" );
+        return EXIT_FAILURE;
+    }
+
+    // -N 0 disables parallel transfer, which leaves no thread count to adapt.
+    if ( adaptive_threads && myRodsArgs.number == True && myRodsArgs.numberValue < 1 ) {
+        fprintf( stderr, "Error: --adaptive-threads cannot be used with -N 0.\n" );
+        return EXIT_FAILURE;
+    }
+
     if ( myRodsArgs.reconnect == True ) {
         reconnFlag = RECONN_TIMEOUT;
     }
@@ -93,7 +1155,13 @@ main( int argc, char **argv ) {
         gGuiProgressCB = ( guiProgressCallback ) iCommandProgStat;
     }
 
-    status = putUtil( &conn, &myEnv, &myRodsArgs, &rodsPathInp );
+    if ( workers > 0 ) {
+        status = put_concurrently( conn, myEnv, myRodsArgs, rodsPathInp, workers, reconnFlag,
+                                   ignore_symlinks, adaptive_threads, dedupe );
+    }
+    else {
+        status = putUtil( &conn, &myEnv, &myRodsArgs, &rodsPathInp );
+    }
 
     printErrorStack( conn->rError );
     rcDisconnect( conn );
@@ -120,6 +1188,10 @@ usage( FILE* _fout ) {
         "             [--lfrestart lfRestartFile] [--retries count]",
         "             [--purgec] [--kv_pass=key-value-string] [--metadata=avu-string]",
         "             [--acl=acl-string]  localSrcFile|localSrcDir ...  destDataObj|destColl",
+        "Usage: iput --workers N [-fkKrTvV] [-D dataType] [-N numThreads] [-R resource]",
+        "             [--adaptive-threads] [--dedupe] [--ignore-symlinks]",
+        "             [--kv_pass=key-value-string] [--metadata=avu-string]",
+        "             [--acl=acl-string]  localSrcFile|localSrcDir ...  destColl",
         "Usage: iput [-abfIkKPtTUvV] [-D dataType] [-N numThreads] [-n replNum] ",
         "             [-R resource] [-X restartFile] [--ignore-symlinks]",
         "             [--lfrestart lfRestartFile] [--retries count]",
@@ -170,6 +1242,47 @@ usage( FILE* _fout ) {
         "To overwrite a collection using bulk upload, the existing collection should be",
         "removed or renamed beforehand.",
         " ",
+        "The --workers option uploads files concurrently over N additional connections,",
+        "each taking the next file from a shared queue as soon as its previous upload",
+        "finishes. The main connection creates the collections and queues the files.",
+        "This hides per-file round trip latency when uploading many small files and,",
+        "unlike -b, can be combined with -f. It cannot be combined with -b, -I, -P,",
+        "-X, --lfrestart, or --retries.",
+        " ",
+        "The --adaptive-threads option chooses the number of transfer threads for",
+        "files of 32 MB or more from the measured upload throughput, instead of using",
+        "-N or leaving the choice to the server. Throughput is the number of bytes all",
+        "workers upload over a span of wall-clock time covering at least one file per",
+        "worker. It starts with 2 threads and doubles the count while each step raises",
+        "throughput by at least 5%. It then holds the best count, periodically trying",
+        "twice or half as many threads, and moves to fewer threads whenever that costs",
+        "less than 5% of the throughput. -N sets the upper bound, which is otherwise",
+        "64, and cannot be 0. With -v, each change is printed. It implies --workers 1",
+        "unless --workers is given.",
+        " ",
+        "With -K, each file is checksummed on another thread while it is sent, and",
+        "the server computes and registers the checksum of the replica it writes.",
+        "The two are compared once the upload completes, so the file is not read",
+        "completely before it is sent. Replicas whose registered checksum uses another",
+        "hash scheme than your environment are not compared, and a warning is printed.",
+        "-K implies --workers 1 unless --workers is given or -K is combined with -b,",
+        "-I, -P, -X, --lfrestart, or --retries, in which case each file is read to",
+        "checksum it before it is sent. Files whose target path contains a single",
+        "quote are also checksummed before they are sent.",
+        " ",
+        "The --dedupe option avoids sending files whose contents are already stored in",
+        "the destination collection (or its sub-collections). The workers checksum files",
+        "in batches, using the hash scheme of your environment, and look the checksums",
+        "up in the catalog with one query per batch. A file matching its own target",
+        "data object is skipped. A file matching another data object with a good",
+        "replica of the same size is copied from it on the server. Other files are",
+        "uploaded; with -k or -K, the server verifies them against the batch",
+        "checksum, so they are not read again to checksum them. Copies honor -R, -f,",
+        "-k, and -K. Only data objects with catalog checksums (see -k) can match. It",
+        "cannot be combined with -D, --metadata, --acl, or --kv_pass, which would not",
+        "be applied to skipped or copied files. It implies --workers 1 unless",
+        "--workers is given.",
+        " ",
         "Options are:",
         " -a  all - update all existing copies",
         " -b  bulk upload to reduce overhead",
@@ -212,6 +1325,9 @@ usage( FILE* _fout ) {
         " --acl - atomically apply ACLs of the form",
         "          'perm user_or_group;perm user_or_group;'",
         "          where 'perm' is defined as null|read|write|own",
+        " --workers N - upload files concurrently over N connections, at most 64.",
+        " --adaptive-threads - tune the number of transfer threads from throughput.",
+        " --dedupe - skip or copy on the server files already stored in iRODS.",
         " -h  this help",
         ""
     };
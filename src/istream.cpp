@@ -6,21 +6,50 @@
 #include <irods/rcMisc.h>
 #include <irods/rodsPath.h>
 #include <irods/irods_at_scope_exit.hpp>
+#include <irods/irods_query.hpp>
 #include <irods/replica.hpp>
+#include <irods/data_object_modify_info.h>
 
 #include "utility.hpp"
 
 #include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+
+#include <openssl/evp.h>
 
 #include <cstdlib>
 #include <iostream>
 #include <limits>
 #include <string>
+#include <string_view>
 #include <array>
 #include <tuple>
 #include <optional>
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 namespace io = irods::experimental::io;
 namespace ir = irods::experimental::replica;
@@ -28,307 +57,1893 @@ namespace po = boost::program_options;
 
 using int_type = std::int64_t;
 
-// clang-format off
-constexpr auto buffer_size = 4 * 1024 * 1024;
-constexpr auto all_bytes   = std::numeric_limits<int_type>::max();
-// clang-format on
+struct byte_range
+{
+    int_type offset;
+    int_type length;
+};
 
-auto usage() -> void;
+using stats_clock = std::chrono::steady_clock;
+using seconds = std::chrono::duration<double>;
 
-auto check_input_arguments(const po::variables_map& vm) -> std::tuple<bool, int>;
+// Counters describing one side (network or local) of a transfer. The counters are
+// atomic so that the readers and writers of parallel transfers can share them.
+class io_stats
+{
+  public:
+    // Histogram buckets double in width, starting with operations that complete in
+    // less than 64 microseconds. The last bucket is unbounded.
+    static constexpr auto n_buckets = 20;
+    static constexpr auto first_bucket_bits = 6;
+
+    // Invokes "func" as one operation and returns its result along with the time it
+    // took. The wall-clock time during which at least one operation is in progress is
+    // tracked separately from the summed duration, as parallel streams overlap.
+    template <typename Func>
+    auto timed(Func&& func)
+    {
+        const auto start = stats_clock::now();
 
-auto canonical(const std::string& path, rodsEnv& env) -> std::optional<std::string>;
+        {
+            std::lock_guard lock{active_mutex_};
 
-auto stream_bytes(std::istream& in, std::ostream& out, int_type count) -> int;
+            if (0 == active_operations_++) {
+                active_since_ = start;
+            }
+        }
 
-auto read_data_object(rodsEnv& env,
-                      const po::variables_map& vm,
-                      irods::experimental::client_connection& conn,
-                      io::client::default_transport& tp) -> int;
+        irods::at_scope_exit end_operation{[this] {
+            std::lock_guard lock{active_mutex_};
 
-auto write_data_object(rodsEnv& env, const po::variables_map& vm, io::client::default_transport& tp) -> int;
+            if (0 == --active_operations_) {
+                active_ += stats_clock::now() - active_since_;
+            }
+        }};
 
-int main(int argc, char* argv[])
-{
-    utils::set_ips_display_name(boost::filesystem::path{argv[0]}.filename().c_str());
+        auto result = std::forward<Func>(func)();
+        return std::make_pair(std::move(result), stats_clock::now() - start);
+    }
 
-    po::options_description desc{""};
-    desc.add_options()
-        ("help,h", "")
-        ("resource,R", po::value<std::string>(), "")
-        ("replica,n", po::value<int>(), "")
-        ("offset,o", po::value<int_type>()->default_value(0), "")
-        ("count,c", po::value<int_type>()->default_value(all_bytes), "")
-        ("no-trunc", po::bool_switch(), "")
-        ("append,a", po::bool_switch(), "")
-        ("checksum,k", po::bool_switch(), "")
-        ("stream_operation", po::value<std::string>(), "")
-        ("logical_path", po::value<std::string>(), "");
+    auto record(int_type bytes, stats_clock::duration d) -> void
+    {
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        const auto bucket = std::clamp<int>(std::bit_width(static_cast<std::uint64_t>(us)) - first_bucket_bits,
+                                            0,
+                                            n_buckets - 1);
+
+        bytes_ += bytes;
+        ++operations_;
+        busy_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        ++histogram_[bucket];
+    }
 
-    po::positional_options_description pod;
-    pod.add("stream_operation", 1);
-    pod.add("logical_path", 1);
+    auto bytes() const -> int_type
+    {
+        return bytes_;
+    }
 
-    try {
-        po::variables_map vm;
-        po::store(po::command_line_parser(argc, argv).options(desc).positional(pod).run(), vm);
-        po::notify(vm);
+    auto to_json(seconds elapsed) const -> nlohmann::json
+    {
+        const auto busy = seconds{std::chrono::nanoseconds{busy_ns_.load()}};
 
-        if (const auto [return_ec, ec] = check_input_arguments(vm); return_ec) {
-            return ec;
+        seconds active;
+
+        {
+            std::lock_guard lock{active_mutex_};
+            active = active_;
         }
 
-        load_client_api_plugins();
+        auto histogram = nlohmann::json::array();
 
-        rodsEnv env;
-        if (getRodsEnv(&env) < 0) {
-            std::cerr << "Error: Could not get iRODS environment.\n";
-            return 1;
+        for (int i = 0; i < n_buckets; ++i) {
+            if (const auto n = histogram_[i].load(); n > 0) {
+                nlohmann::json bucket{{"count", n}};
+
+                if (i < n_buckets - 1) {
+                    bucket["upper_bound_microseconds"] = std::uint64_t{1} << (i + first_bucket_bits);
+                }
+
+                histogram.push_back(std::move(bucket));
+            }
         }
 
-        irods::experimental::client_connection conn;
+        return {{"bytes", bytes_.load()},
+                {"operations", operations_.load()},
+                {"busy_seconds", busy.count()},
+                {"active_seconds", active.count()},
+                {"stalled_seconds", std::max(elapsed - active, seconds{0}).count()},
+                {"latency_histogram", std::move(histogram)}};
+    }
 
-        irods::at_scope_exit print_errors_on_exit{[&conn] {
-            printErrorStack(static_cast<rcComm_t*>(conn)->rError);
-        }};
+  private:
+    std::atomic<int_type> bytes_ = 0;
+    std::atomic<std::uint64_t> operations_ = 0;
+    std::atomic<std::int64_t> busy_ns_ = 0;
+    std::array<std::atomic<std::uint64_t>, n_buckets> histogram_{};
 
-        io::client::default_transport tp{conn};
+    mutable std::mutex active_mutex_;
+    int active_operations_ = 0;
+    stats_clock::time_point active_since_;
+    stats_clock::duration active_{};
+}; // class io_stats
 
-        const auto stream_operation = vm["stream_operation"].as<std::string>();
+struct transfer_stats
+{
+    stats_clock::time_point start = stats_clock::now();
+    seconds connect_latency{};
+    seconds open_latency{};
+    seconds close_latency{};
+    io_stats network;
+    io_stats local;
+};
 
-        if ("read" == stream_operation) {
-            return read_data_object(env, vm, conn, tp);
-        }
+auto print_stats(const transfer_stats& stats, const std::string& format) -> void;
+
+// clang-format off
+constexpr auto default_buffer_size = 4 * 1024 * 1024;
+constexpr auto max_buffer_size     = 1024 * 1024 * 1024;
+constexpr auto buffer_count        = 4;
+constexpr auto journal_interval    = 64 * 1024 * 1024;
+constexpr auto all_bytes           = std::numeric_limits<int_type>::max();
+// clang-format on
 
-        if ("write" == stream_operation) {
-            return write_data_object(env, vm, tp);
+auto usage() -> void;
+
+auto check_input_arguments(const po::variables_map& vm) -> std::tuple<bool, int>;
+
+auto canonical(const std::string& path, rodsEnv& env) -> std::optional<std::string>;
+
+class sha256_digest;
+
+template <typename Source, typename Sink>
+auto stream_bytes(Source& in, Sink& out, int_type count, std::size_t buffer_size, sha256_digest* digest = nullptr)
+    -> int;
+
+auto read_data_object(rodsEnv& env,
+                      const po::variables_map& vm,
+                      io::client::default_transport& tp,
+                      transfer_stats& stats) -> int;
+
+auto stream_size(io::idstream& in) -> std::optional<int_type>;
+
+auto read_data_object_parallel(const std::string& path,
+                               io::idstream& in,
+                               int_type offset,
+                               int_type count,
+                               int n_streams,
+                               std::size_t buffer_size,
+                               transfer_stats& stats) -> int;
+
+auto parse_ranges(const std::string& file) -> std::optional<std::vector<byte_range>>;
+
+auto read_data_object_ranges(io::idstream& in,
+                             const std::vector<byte_range>& ranges,
+                             int_type replica_size,
+                             std::size_t buffer_size,
+                             transfer_stats& stats) -> int;
+
+auto read_data_object_batch(rodsEnv& env,
+                            const po::variables_map& vm,
+                            io::client::default_transport& tp,
+                            transfer_stats& stats) -> int;
+
+auto write_data_object(rodsEnv& env,
+                       const po::variables_map& vm,
+                       irods::experimental::client_connection& conn,
+                       io::client::default_transport& tp,
+                       transfer_stats& stats) -> int;
+
+auto parallel_write_size(int fd, int_type count) -> std::optional<int_type>;
+
+auto write_data_object_parallel(const std::string& path,
+                                io::odstream& out,
+                                int fd,
+                                int_type offset,
+                                int_type count,
+                                int n_streams,
+                                std::size_t buffer_size,
+                                transfer_stats& stats) -> int;
+
+auto register_checksum(irods::experimental::client_connection& conn,
+                       const std::string& path,
+                       int replica_number,
+                       const std::string& checksum) -> int;
+
+auto skip_input(int fd, int_type n, std::size_t buffer_size) -> bool;
+
+auto replica_locked(rcComm_t& comm, const std::string& path, int replica_number) -> bool;
+
+auto replica_in_resource(rcComm_t& comm, const std::string& path, int replica_number, const std::string& resource)
+    -> bool;
+
+// A fixed-capacity byte buffer backed by an anonymous memory mapping. Pages handed
+// to a pipe via vmsplice remain referenced by the kernel after they are written, so
+// the memory must never be recycled by the heap while the pipe may still read it.
+// Unmapping leaves those pages intact, which malloc/free does not guarantee.
+class io_buffer
+{
+  public:
+    explicit io_buffer(std::size_t capacity)
+        : data_{static_cast<char*>(mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0))}
+        , size_{capacity}
+        , capacity_{capacity}
+    {
+        if (MAP_FAILED == data_) {
+            throw std::bad_alloc{};
         }
+    }
 
-        std::cerr << "Error: Invalid stream operation [" << stream_operation << "]\n";
+    io_buffer(const io_buffer&) = delete;
+    auto operator=(const io_buffer&) -> io_buffer& = delete;
 
-        return 1;
+    io_buffer(io_buffer&& other) noexcept
+        : data_{std::exchange(other.data_, nullptr)}
+        , size_{other.size_}
+        , capacity_{other.capacity_}
+    {
     }
-    catch (const std::exception& e) {
-        std::cerr << "Error: " << e.what() << '\n';
-        return 1;
+
+    auto operator=(io_buffer&& other) noexcept -> io_buffer&
+    {
+        if (this != &other) {
+            release();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+        }
+
+        return *this;
     }
-}
 
-auto usage() -> void
-{
-    std::cout << "Usage: istream read [-R RESC_NAME] [-o INTEGER] [-c INTEGER] LOGICAL_PATH\n"
-                 "Usage: istream read [-n REPLICA_NUMBER] [-o INTEGER] [-c INTEGER] LOGICAL_PATH\n"
-                 "Usage: istream write [-R RESC_NAME] [-k] [-o INTEGER] [-c INTEGER] [--no-trunc] [-a] LOGICAL_PATH\n"
-                 "Usage: istream write [-n REPLICA_NUMBER] [-k] [-o INTEGER] [-c INTEGER] [--no-trunc] [-a] LOGICAL_PATH\n"
-                 "\n"
-                 "Streams bytes to/from iRODS via stdin/stdout.\n"
-                 "Reads bytes from the target data object and prints them to stdout.\n"
-                 "Writes bytes from stdin to the target data object.\n"
-                 "\n"
-                 "Writing to a non-existent data object will create it by default.\n"
-                 "Writing to an existing data object always truncates it.  Truncation can be\n"
-                 "disabled by passing --no-trunc.  However, using --no-trunc disables creation\n"
-                 "of data objects.\n"
-                 "\n"
-                 "If the client-side of the connection is interrupted before the data object\n"
-                 "is closed, then the catalog will not be updated and the data object will have\n"
-                 "a replica status of intermediate or stale.  Information such as data object\n"
-                 "size and checksum will not be available.\n"
-                 "\n"
-                 "If the target data object does not reside on the connected server, istream\n"
-                 "will not attempt to redirect to the server hosting the replica.  Traffic will\n"
-                 "always flow through the connected server.\n"
-                 "\n"
-                 "Options:\n"
-                 "-R, --resource  The root resource to read from or write to.  Cannot be used\n"
-                 "                with --replica.\n"
-                 "-n, --replica   The replica number of the replica to read from or write to.\n"
-                 "                Replica numbers cannot be used to create new data objects.\n"
-                 "                Cannot be used with --resource.\n"
-                 "-o, --offset    The number of bytes to skip within the data object before\n"
-                 "                reading/writing.  Value must be positive.  Defaults to zero.\n"
-                 "-c, --count     The number of bytes to read/write.  Value must be positive.\n"
-                 "                Defaults to all bytes.\n"
-                 "-a, --append    Appends bytes read from stdin to the data object.  Implies\n"
-                 "                --no-trunc.\n"
-                 "    --no-trunc  Does not truncate the data object.  Disables creation of data\n"
-                 "                objects.  Ignored by write operations when --append is set.\n"
-                 "-k, --checksum  Compute checksum.\n"
-                 "-h, --help      Prints this message\n";
+    ~io_buffer()
+    {
+        release();
+    }
 
-    printReleaseInfo("istream");
-}
+    auto data() noexcept -> char*
+    {
+        return data_;
+    }
 
-auto check_input_arguments(const po::variables_map& vm) -> std::tuple<bool, int>
-{
-    if (vm.count("help")) {
-        usage();
-        return {true, 0};
+    auto size() const noexcept -> std::size_t
+    {
+        return size_;
     }
 
-    const auto is_valid_operation = [](const auto& op)
+    auto capacity() const noexcept -> std::size_t
     {
-        const auto ops = {"read", "write"};
-        return std::any_of(std::begin(ops), std::end(ops), [&op] (auto&& other_op) {
-            return op == other_op;
-        });
-    };
+        return capacity_;
+    }
 
-    if (vm.count("stream_operation") == 0 || !is_valid_operation(vm["stream_operation"].as<std::string>())) {
-        std::cerr << "Error: Missing stream operation.\n";
-        return {true, 1};
+    auto resize(std::size_t size) noexcept -> void
+    {
+        size_ = std::min(size, capacity_);
     }
 
-    if (vm.count("logical_path") == 0) {
-        std::cerr << "Error: Missing logical path.\n";
-        return {true, 1};
+  private:
+    auto release() noexcept -> void
+    {
+        if (data_) {
+            munmap(data_, capacity_);
+        }
     }
 
-    return {false, 0};
-}
+    char* data_;
+    std::size_t size_;
+    std::size_t capacity_;
+}; // class io_buffer
 
-auto canonical(const std::string& path, rodsEnv& env) -> std::optional<std::string>
+// Reads from a data object stream.
+class dstream_source
 {
-    rodsPath_t input{};
-    rstrcpy(input.inPath, path.data(), MAX_NAME_LEN);
+  public:
+    explicit dstream_source(std::istream& in)
+        : in_{in}
+    {
+    }
 
-    if (parseRodsPath(&input, &env) != 0) {
-        return std::nullopt;
+    auto read(char* buf, int_type n) -> int_type
+    {
+        in_.read(buf, n);
+        return in_.gcount();
     }
 
-    auto* escaped_path = escape_path(input.outPath);
-    std::optional<std::string> p = escaped_path;
-    std::free(escaped_path);
+    auto good() const -> bool
+    {
+        return static_cast<bool>(in_);
+    }
 
-    return p;
-}
+    auto eof() const -> bool
+    {
+        return in_.eof();
+    }
 
-auto stream_bytes(std::istream& in, std::ostream& out, int_type count) -> int
+  private:
+    std::istream& in_;
+}; // class dstream_source
+
+// Records how many bytes of a write have been confirmed by the server, so that an
+// interrupted transfer can be resumed from that point. The journal is replaced
+// atomically on every update, so a crash never leaves a partially written journal.
+class progress_journal
 {
-    if (count < 0) {
-        std::cerr << "Error: Invalid byte count.\n";
-        return 1;
+  public:
+    progress_journal(std::string file, std::string logical_path, int_type offset)
+        : file_{std::move(file)}
+        , logical_path_{std::move(logical_path)}
+        , offset_{offset}
+    {
     }
 
-    std::array<char, buffer_size> buf;
+    // Loads the progress of a previous run, if there was one. Returns false if the
+    // journal cannot be read or describes a different transfer.
+    auto load() -> bool
+    {
+        std::ifstream in{file_};
 
-    if (all_bytes == count) {
-        while (in && out) {
-            in.read(buf.data(), buf.size());
-            out.write(buf.data(), in.gcount());
+        if (!in) {
+            return true;
         }
 
-        if (!in.eof()) {
-            std::cerr << "Error: Failed to read all bytes.\n";
-            return 1;
-        }
+        try {
+            const auto j = nlohmann::json::parse(in);
 
-        if (!out) {
-            std::cerr << "Error: Failed to write all bytes to data object.\n";
-            return 1;
+            if (j.at("logical_path").get<std::string>() != logical_path_ || j.at("offset").get<int_type>() != offset_) {
+                std::cerr << "Error: Journal [" << file_ << "] describes a different transfer.\n";
+                return false;
+            }
+
+            replica_number_ = j.at("replica_number").get<int>();
+            bytes_written_ = j.at("bytes_written").get<int_type>();
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: Cannot read journal [" << file_ << "]: " << e.what() << '\n';
+            return false;
         }
 
-        return 0;
+        return true;
     }
 
-    int_type bytes_read = 0;
-
-    for (int_type i = 0, n_reads = count / buffer_size; i < n_reads; ++i) {
-        if (in && out) {
-            in.read(buf.data(), buf.size());
-            out.write(buf.data(), in.gcount());
-            bytes_read += in.gcount();
-        }
+    auto resuming() const -> bool
+    {
+        return replica_number_.has_value();
     }
 
-    if (const auto remainder = count % buffer_size; remainder > 0 && in && out) {
-        in.read(buf.data(), remainder);
-        out.write(buf.data(), in.gcount());
-        bytes_read += in.gcount();
+    auto replica_number() const -> std::optional<int>
+    {
+        return replica_number_;
     }
 
-    if (bytes_read != count) {
-        std::cerr << "Error: Failed to read requested number of bytes.\n";
-        return 1;
+    // The number of bytes confirmed by previous runs.
+    auto bytes_written() const -> int_type
+    {
+        return bytes_written_;
     }
 
-    if (!out) {
-        std::cerr << "Error: Failed to write requested number of bytes to data object.\n";
-        return 1;
+    auto begin(int replica_number) -> bool
+    {
+        replica_number_ = replica_number;
+        return save(bytes_written_);
     }
 
-    return 0;
-}
-
-auto read_data_object(rodsEnv& env,
-                      const po::variables_map& vm,
-                      irods::experimental::client_connection& conn,
-                      io::client::default_transport& tp) -> int
-{
-    if (vm["append"].as<bool>()) {
-        std::cerr << "Error: Invalid option on read: --append\n";
-        return 1;
+    // Records that "n" bytes have been confirmed by this run.
+    auto record(int_type n) -> bool
+    {
+        return save(bytes_written_ + n);
     }
 
-    if (vm["no-trunc"].as<bool>()) {
-        std::cerr << "Error: Invalid option on read: --no-trunc.\n";
-        return 1;
+    auto remove() -> void
+    {
+        std::remove(file_.c_str());
     }
 
-    std::string path;
+  private:
+    auto save(int_type bytes_written) -> bool
+    {
+        const auto tmp = file_ + ".tmp";
+        const auto contents = nlohmann::json{{"logical_path", logical_path_},
+                                             {"offset", offset_},
+                                             {"replica_number", *replica_number_},
+                                             {"bytes_written", bytes_written}}
+                                  .dump();
 
-    if (auto v = canonical(vm["logical_path"].as<std::string>(), env); v) {
-        path = *v;
+        const auto fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+
+        if (fd < 0) {
+            return false;
+        }
+
+        const auto ok = ::write(fd, contents.data(), contents.size()) == static_cast<ssize_t>(contents.size()) &&
+                        fsync(fd) == 0;
+        ::close(fd);
+
+        return ok && std::rename(tmp.c_str(), file_.c_str()) == 0;
     }
-    else {
-        std::cerr << "Error: Failed to convert path to absolute path.\n";
-        return 1;
+
+    std::string file_;
+    std::string logical_path_;
+    int_type offset_;
+    std::optional<int> replica_number_;
+    int_type bytes_written_ = 0;
+}; // class progress_journal
+
+// Writes to a data object stream. When a journal is attached, the stream is
+// flushed periodically and the number of bytes accepted by the server is recorded.
+class dstream_sink
+{
+  public:
+    explicit dstream_sink(std::ostream& out, progress_journal* journal = nullptr)
+        : out_{out}
+        , journal_{journal}
+    {
     }
 
-    io::idstream in;
+    auto write(const char* buf, int_type n) -> bool
+    {
+        if (!out_.write(buf, n)) {
+            return false;
+        }
 
-    if (vm.count("resource")) {
-        if (vm.count("replica")) {
-            std::cerr << "Error: --resource and --replica cannot be used together.\n";
-            return 1;
+        written_ += n;
+
+        if (journal_ && written_ - checkpoint_ >= journal_interval) {
+            if (!out_.flush()) {
+                return false;
+            }
+
+            // A journal which falls behind the data object would make a resumed run skip
+            // the wrong number of input bytes, so the transfer stops here.
+            if (!journal_->record(written_)) {
+                std::cerr << "Error: Could not update journal.\n";
+                return false;
+            }
+
+            checkpoint_ = written_;
         }
 
-        in.open(tp, path, io::root_resource_name{vm["resource"].as<std::string>()});
+        return true;
     }
-    else if (vm.count("replica")) {
-        in.open(tp, path, io::replica_number{vm["replica"].as<int>()});
+
+    auto good() const -> bool
+    {
+        return static_cast<bool>(out_);
     }
-    else {
-        in.open(tp, path);
+
+    // Whether written buffers may still be referenced after a successful write.
+    auto splicing() const -> bool
+    {
+        return false;
     }
 
-    if (!in) {
-        std::cerr << "Error: Cannot open data object.\n";
-        return 1;
+  private:
+    std::ostream& out_;
+    progress_journal* journal_;
+    int_type written_ = 0;
+    int_type checkpoint_ = 0;
+}; // class dstream_sink
+
+// Reads from a file descriptor directly. For stdin, this bypasses the copy into
+// std::cin's buffer.
+class fd_source
+{
+  public:
+    explicit fd_source(int fd)
+        : fd_{fd}
+    {
     }
 
-    if (const auto offset = vm["offset"].as<int_type>(); offset >= 0) {
-        if (!in.seekg(offset)) {
-            std::cerr << "Error: Could not seek to offset.\n";
-            return 1;
+    auto read(char* buf, int_type n) -> int_type
+    {
+        int_type total = 0;
+
+        while (total < n) {
+            const auto ec = ::read(fd_, buf + total, n - total);
+
+            if (ec > 0) {
+                total += ec;
+            }
+            else if (0 == ec) {
+                eof_ = true;
+                break;
+            }
+            else if (EINTR != errno) {
+                failed_ = true;
+                break;
+            }
         }
-    }
-    else {
-        std::cerr << "Error: Invalid byte offset.\n";
-        return 1;
-    }
 
-    const auto count = std::min<int_type>(ir::replica_size<RcComm>(conn, path, in.replica_number().value),
-                                          vm["count"].as<int_type>());
+        return total;
+    }
 
-    if (const auto ec = stream_bytes(in, std::cout, count); ec) {
-        return ec;
+    auto good() const -> bool
+    {
+        return !eof_ && !failed_;
+    }
+
+    auto eof() const -> bool
+    {
+        return eof_;
+    }
+
+  private:
+    int fd_;
+    bool eof_ = false;
+    bool failed_ = false;
+}; // class fd_source
+
+// Writes to stdout using the file descriptor directly, bypassing std::cout.
+// When stdout is a pipe and splicing is requested, pages are mapped into the pipe
+// with vmsplice instead of being copied. A reader which splices or tees the pages
+// onward keeps referencing them for an unbounded amount of time, so a buffer
+// written this way must never be modified again. See splicing().
+class stdout_sink
+{
+  public:
+    explicit stdout_sink(bool use_splice)
+    {
+        struct stat st{};
+
+        splice_ = use_splice && fstat(STDOUT_FILENO, &st) == 0 && S_ISFIFO(st.st_mode);
+    }
+
+    auto write(const char* buf, int_type n) -> bool
+    {
+        return write(buf, n, splice_);
+    }
+
+    // Always copies the bytes, so "buf" may be released as soon as this returns.
+    auto write_copy(const char* buf, int_type n) -> bool
+    {
+        return write(buf, n, false);
+    }
+
+    auto good() const -> bool
+    {
+        return !failed_;
+    }
+
+    // Whether written buffers may still be referenced after a successful write.
+    auto splicing() const -> bool
+    {
+        return splice_;
+    }
+
+  private:
+    auto write(const char* buf, int_type n, bool splice) -> bool
+    {
+        if (failed_) {
+            return false;
+        }
+
+        int_type total = 0;
+
+        while (total < n) {
+            ssize_t ec;
+
+            if (splice) {
+                iovec iov{const_cast<char*>(buf + total), static_cast<std::size_t>(n - total)};
+                ec = vmsplice(STDOUT_FILENO, &iov, 1, 0);
+            }
+            else {
+                ec = ::write(STDOUT_FILENO, buf + total, n - total);
+            }
+
+            if (ec >= 0) {
+                total += ec;
+            }
+            else if (EINTR != errno) {
+                failed_ = true;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool splice_ = false;
+    bool failed_ = false;
+}; // class stdout_sink
+
+// Records the duration and size of every read from "Source".
+template <typename Source>
+class timed_source
+{
+  public:
+    timed_source(Source& source, io_stats& stats)
+        : source_{source}
+        , stats_{stats}
+    {
+    }
+
+    auto read(char* buf, int_type n) -> int_type
+    {
+        const auto [bytes_read, d] = stats_.timed([&] { return source_.read(buf, n); });
+        stats_.record(bytes_read, d);
+        return bytes_read;
+    }
+
+    auto good() const -> bool
+    {
+        return source_.good();
+    }
+
+    auto eof() const -> bool
+    {
+        return source_.eof();
+    }
+
+  private:
+    Source& source_;
+    io_stats& stats_;
+}; // class timed_source
+
+// Records the duration and size of every write to "Sink".
+template <typename Sink>
+class timed_sink
+{
+  public:
+    timed_sink(Sink& sink, io_stats& stats)
+        : sink_{sink}
+        , stats_{stats}
+    {
+    }
+
+    auto write(const char* buf, int_type n) -> bool
+    {
+        const auto [ok, d] = stats_.timed([&] { return sink_.write(buf, n); });
+        stats_.record(ok ? n : 0, d);
+        return ok;
+    }
+
+    auto good() const -> bool
+    {
+        return sink_.good();
+    }
+
+    auto splicing() const -> bool
+    {
+        return sink_.splicing();
+    }
+
+  private:
+    Sink& sink_;
+    io_stats& stats_;
+}; // class timed_sink
+
+// Computes a SHA-256 digest incrementally using OpenSSL's EVP interface, which
+// selects the fastest implementation supported by the CPU (e.g. SHA extensions).
+class sha256_digest
+{
+  public:
+    sha256_digest()
+        : ctx_{EVP_MD_CTX_new()}
+    {
+        if (!ctx_ || !EVP_DigestInit_ex(ctx_, EVP_sha256(), nullptr)) {
+            EVP_MD_CTX_free(ctx_);
+            throw std::runtime_error{"Could not initialize SHA-256 digest."};
+        }
+    }
+
+    sha256_digest(const sha256_digest&) = delete;
+    auto operator=(const sha256_digest&) -> sha256_digest& = delete;
+
+    ~sha256_digest()
+    {
+        EVP_MD_CTX_free(ctx_);
+    }
+
+    auto update(const char* buf, std::size_t n) -> void
+    {
+        EVP_DigestUpdate(ctx_, buf, n);
+    }
+
+    // Returns the digest in the format used by iRODS for SHA-256 checksums. Must only
+    // be called once.
+    auto checksum() -> std::string
+    {
+        std::array<unsigned char, EVP_MAX_MD_SIZE> md{};
+        unsigned int md_size = 0;
+        EVP_DigestFinal_ex(ctx_, md.data(), &md_size);
+
+        // Base64 produces 4 bytes for every 3 bytes of input, plus a null terminator.
+        std::array<unsigned char, 4 * ((EVP_MAX_MD_SIZE + 2) / 3) + 1> encoded{};
+        const auto n = EVP_EncodeBlock(encoded.data(), md.data(), static_cast<int>(md_size));
+
+        return "sha2:" + std::string(reinterpret_cast<const char*>(encoded.data()), n);
+    }
+
+  private:
+    EVP_MD_CTX* ctx_;
+}; // class sha256_digest
+
+// A blocking FIFO used to hand buffers back and forth between the reader and
+// writer threads of byte_pipeline. Once closed, pop() drains the remaining
+// buffers and then returns an empty optional until the queue is reopened.
+class buffer_queue
+{
+  public:
+    auto push(io_buffer buf) -> void
+    {
+        {
+            std::scoped_lock lk{mtx_};
+            buffers_.push_back(std::move(buf));
+        }
+
+        cv_.notify_one();
+    }
+
+    auto pop() -> std::optional<io_buffer>
+    {
+        std::unique_lock lk{mtx_};
+        cv_.wait(lk, [this] { return closed_ || !buffers_.empty(); });
+
+        if (buffers_.empty()) {
+            return std::nullopt;
+        }
+
+        auto buf = std::move(buffers_.front());
+        buffers_.pop_front();
+
+        return buf;
+    }
+
+    auto close() -> void
+    {
+        {
+            std::scoped_lock lk{mtx_};
+            closed_ = true;
+        }
+
+        cv_.notify_all();
+    }
+
+    auto reopen() -> void
+    {
+        std::scoped_lock lk{mtx_};
+        closed_ = false;
+    }
+
+  private:
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<io_buffer> buffers_;
+    bool closed_ = false;
+}; // class buffer_queue
+
+// Moves bytes from a source to a sink. A reader thread fills buffers from the source
+// while the calling thread drains them into the sink. Because the number of buffers
+// is fixed, neither queue can ever hold more than the number of buffers allocated
+// by the constructor. The buffers and the reader thread are kept across calls to
+// run(), so streaming many small data objects does not pay for them every time.
+class byte_pipeline
+{
+  public:
+    explicit byte_pipeline(std::size_t buffer_size)
+        : buffer_size_{buffer_size}
+    {
+        for (std::size_t i = 0; i < buffer_count; ++i) {
+            empty_buffers_.push(io_buffer{buffer_size_});
+        }
+
+        reader_ = std::thread{[this] { run_jobs(); }};
+    }
+
+    byte_pipeline(const byte_pipeline&) = delete;
+    auto operator=(const byte_pipeline&) -> byte_pipeline& = delete;
+
+    ~byte_pipeline()
+    {
+        {
+            std::scoped_lock lk{mtx_};
+            stopping_ = true;
+        }
+
+        cv_.notify_all();
+        reader_.join();
+    }
+
+    template <typename Source, typename Sink>
+    auto run(Source& in, Sink& out, int_type count, sha256_digest* digest) -> int
+    {
+        if (count < 0) {
+            std::cerr << "Error: Invalid byte count.\n";
+            return 1;
+        }
+
+        int_type bytes_read = 0;
+        std::atomic<bool> write_failed = false;
+
+        // Exceptions must not escape the reader thread. They are rethrown on this thread
+        // once the reader has finished.
+        std::exception_ptr read_error;
+
+        start_job([&] {
+            irods::at_scope_exit close_full_buffers{[this] { full_buffers_.close(); }};
+
+            try {
+                while (bytes_read < count && !write_failed) {
+                    auto buf = empty_buffers_.pop();
+
+                    if (!buf) {
+                        return;
+                    }
+
+                    const auto n = in.read(buf->data(), std::min<int_type>(buf->capacity(), count - bytes_read));
+
+                    if (n > 0) {
+                        if (digest) {
+                            digest->update(buf->data(), n);
+                        }
+
+                        buf->resize(n);
+                        bytes_read += n;
+                        full_buffers_.push(std::move(*buf));
+                    }
+                    else {
+                        empty_buffers_.push(std::move(*buf));
+                    }
+
+                    if (!in.good()) {
+                        return;
+                    }
+                }
+            }
+            catch (...) {
+                read_error = std::current_exception();
+            }
+        });
+
+        std::optional<io_buffer> unwritten;
+        bool finished = false;
+
+        // Waits for the reader and returns every buffer to the pool so that the next run
+        // starts from the same state. This must also happen if the sink throws, as the
+        // reader refers to this stack frame.
+        const auto finish = [&] {
+            if (std::exchange(finished, true)) {
+                return;
+            }
+
+            // Unblocks the reader if the writer stopped early.
+            empty_buffers_.close();
+            wait_for_job();
+            empty_buffers_.reopen();
+
+            if (unwritten) {
+                empty_buffers_.push(std::move(*unwritten));
+            }
+
+            while (auto buf = full_buffers_.pop()) {
+                empty_buffers_.push(std::move(*buf));
+            }
+
+            full_buffers_.reopen();
+        };
+
+        irods::at_scope_exit finish_on_exit{finish};
+
+        while (auto buf = full_buffers_.pop()) {
+            if (!out.write(buf->data(), buf->size())) {
+                write_failed = true;
+                unwritten = std::move(buf);
+                break;
+            }
+
+            // Spliced pages may still be referenced by whatever reads the pipe, so they are
+            // replaced rather than reused. Unmapping them does not affect the pipe's copy.
+            if (out.splicing()) {
+                empty_buffers_.push(io_buffer{buffer_size_});
+            }
+            else {
+                empty_buffers_.push(std::move(*buf));
+            }
+        }
+
+        finish();
+
+        if (read_error) {
+            std::rethrow_exception(read_error);
+        }
+
+        // A failed write stops the reader early, so it must be reported before any
+        // shortfall on the input side.
+        if (all_bytes == count) {
+            if (write_failed || !out.good()) {
+                std::cerr << "Error: Failed to write all bytes to data object.\n";
+                return 1;
+            }
+
+            if (!in.eof()) {
+                std::cerr << "Error: Failed to read all bytes.\n";
+                return 1;
+            }
+
+            return 0;
+        }
+
+        if (write_failed) {
+            std::cerr << "Error: Failed to write requested number of bytes to data object.\n";
+            return 1;
+        }
+
+        if (bytes_read != count) {
+            std::cerr << "Error: Failed to read requested number of bytes.\n";
+            return 1;
+        }
+
+        if (!out.good()) {
+            std::cerr << "Error: Failed to write requested number of bytes to data object.\n";
+            return 1;
+        }
+
+        return 0;
+    }
+
+  private:
+    auto start_job(std::function<void()> job) -> void
+    {
+        {
+            std::scoped_lock lk{mtx_};
+            job_ = std::move(job);
+        }
+
+        cv_.notify_all();
+    }
+
+    auto wait_for_job() -> void
+    {
+        std::unique_lock lk{mtx_};
+        cv_.wait(lk, [this] { return !job_; });
+    }
+
+    auto run_jobs() -> void
+    {
+        std::unique_lock lk{mtx_};
+
+        while (true) {
+            cv_.wait(lk, [this] { return stopping_ || job_; });
+
+            if (!job_) {
+                return;
+            }
+
+            lk.unlock();
+            job_();
+            lk.lock();
+
+            job_ = nullptr;
+            cv_.notify_all();
+        }
+    }
+
+    std::size_t buffer_size_;
+    buffer_queue empty_buffers_;
+    buffer_queue full_buffers_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::function<void()> job_;
+    bool stopping_ = false;
+    std::thread reader_;
+}; // class byte_pipeline
+
+// Holds the chunks produced by the parallel readers until they can be written
+// to stdout in order. Readers are not allowed to get more than "window" chunks
+// ahead of the writer, which bounds memory use to "window * buffer_size" bytes.
+class reorder_buffer
+{
+  public:
+    explicit reorder_buffer(std::size_t window)
+        : window_{window}
+    {
+    }
+
+    // Blocks until the chunk at "index" fits inside the window. Returns false
+    // if the transfer failed while waiting.
+    auto wait_for_slot(std::size_t index) -> bool
+    {
+        std::unique_lock lk{mtx_};
+        cv_.wait(lk, [this, index] { return failed_ || index < next_ + window_; });
+        return !failed_;
+    }
+
+    auto put(std::size_t index, std::vector<char> chunk) -> void
+    {
+        {
+            std::scoped_lock lk{mtx_};
+            chunks_.emplace(index, std::move(chunk));
+        }
+
+        cv_.notify_all();
+    }
+
+    // Blocks until the next chunk in sequence is available. Returns an empty
+    // optional if the transfer failed while waiting.
+    auto take_next() -> std::optional<std::vector<char>>
+    {
+        std::unique_lock lk{mtx_};
+        cv_.wait(lk, [this] { return failed_ || chunks_.count(next_) > 0; });
+
+        if (failed_) {
+            return std::nullopt;
+        }
+
+        auto node = chunks_.extract(next_);
+        ++next_;
+        lk.unlock();
+        cv_.notify_all();
+
+        return std::move(node.mapped());
+    }
+
+    auto fail(const std::string& msg) -> void
+    {
+        {
+            std::scoped_lock lk{mtx_};
+            if (!failed_) {
+                failed_ = true;
+                error_ = msg;
+            }
+        }
+
+        cv_.notify_all();
+    }
+
+    auto error() const -> const std::string&
+    {
+        return error_;
+    }
+
+  private:
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::map<std::size_t, std::vector<char>> chunks_;
+    std::size_t next_ = 0;
+    std::size_t window_;
+    bool failed_ = false;
+    std::string error_;
+}; // class reorder_buffer
+
+int main(int argc, char* argv[])
+{
+    utils::set_ips_display_name(boost::filesystem::path{argv[0]}.filename().c_str());
+
+    po::options_description desc{""};
+    desc.add_options()
+        ("help,h", "")
+        ("resource,R", po::value<std::string>(), "")
+        ("replica,n", po::value<int>(), "")
+        ("offset,o", po::value<int_type>()->default_value(0), "")
+        ("count,c", po::value<int_type>()->default_value(all_bytes), "")
+        ("no-trunc", po::bool_switch(), "")
+        ("append,a", po::bool_switch(), "")
+        ("checksum,k", po::bool_switch(), "")
+        ("verify-checksum,K", po::bool_switch(), "")
+        ("register-checksum", po::bool_switch(), "")
+        ("parallel", po::value<int>()->default_value(1), "")
+        ("from", po::value<std::string>(), "")
+        ("ranges", po::value<std::string>(), "")
+        ("batch", po::bool_switch(), "")
+        ("resume-journal", po::value<std::string>(), "")
+        ("buffer-size", po::value<int_type>()->default_value(default_buffer_size), "")
+        ("splice", po::bool_switch(), "")
+        ("stats", po::value<std::string>()->implicit_value("human"), "")
+        ("stream_operation", po::value<std::string>(), "")
+        ("logical_path", po::value<std::string>(), "");
+
+    po::positional_options_description pod;
+    pod.add("stream_operation", 1);
+    pod.add("logical_path", 1);
+
+    try {
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(pod).run(), vm);
+        po::notify(vm);
+
+        if (const auto [return_ec, ec] = check_input_arguments(vm); return_ec) {
+            return ec;
+        }
+
+        transfer_stats stats;
+
+        load_client_api_plugins();
+
+        rodsEnv env;
+        if (getRodsEnv(&env) < 0) {
+            std::cerr << "Error: Could not get iRODS environment.\n";
+            return 1;
+        }
+
+        const auto connect_start = stats_clock::now();
+        irods::experimental::client_connection conn;
+        stats.connect_latency = stats_clock::now() - connect_start;
+
+        irods::at_scope_exit print_errors_on_exit{[&conn] {
+            printErrorStack(static_cast<rcComm_t*>(conn)->rError);
+        }};
+
+        io::client::default_transport tp{conn};
+
+        const auto stream_operation = vm["stream_operation"].as<std::string>();
+        int ec = 1;
+
+        if ("read" == stream_operation) {
+            ec = read_data_object(env, vm, tp, stats);
+        }
+        else if ("write" == stream_operation) {
+            ec = write_data_object(env, vm, conn, tp, stats);
+        }
+        else {
+            std::cerr << "Error: Invalid stream operation [" << stream_operation << "]\n";
+            return 1;
+        }
+
+        if (vm.count("stats")) {
+            print_stats(stats, vm["stats"].as<std::string>());
+        }
+
+        return ec;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+}
+
+auto usage() -> void
+{
+    std::cout << "Usage: istream read [-R RESC_NAME] [-o INTEGER] [-c INTEGER] [--parallel INTEGER]\n"
+                 "                    [--buffer-size INTEGER] [--splice] LOGICAL_PATH\n"
+                 "Usage: istream read [-n REPLICA_NUMBER] [-o INTEGER] [-c INTEGER] [--parallel INTEGER]\n"
+                 "                    [--buffer-size INTEGER] [--splice] LOGICAL_PATH\n"
+                 "Usage: istream read [-R RESC_NAME|-n REPLICA_NUMBER] --ranges FILE LOGICAL_PATH\n"
+                 "Usage: istream read [-R RESC_NAME|-n REPLICA_NUMBER] [--buffer-size INTEGER] [--splice] --batch\n"
+                 "Usage: istream write [-R RESC_NAME] [-k|-K|--register-checksum] [-o INTEGER] [-c INTEGER]\n"
+                 "                     [--no-trunc] [-a] [--parallel INTEGER] [--from FILE]\n"
+                 "                     [--resume-journal FILE] [--buffer-size INTEGER] LOGICAL_PATH\n"
+                 "Usage: istream write [-n REPLICA_NUMBER] [-k|-K|--register-checksum] [-o INTEGER] [-c INTEGER]\n"
+                 "                     [--no-trunc] [-a] [--parallel INTEGER] [--from FILE]\n"
+                 "                     [--resume-journal FILE] [--buffer-size INTEGER] LOGICAL_PATH\n"
+                 "Usage: istream [--stats[=human|json]] read|write ...\n"
+                 "\n"
+                 "Streams bytes to/from iRODS via stdin/stdout.\n"
+                 "Reads bytes from the target data object and prints them to stdout.\n"
+                 "Writes bytes from stdin to the target data object.\n"
+                 "\n"
+                 "Writing to a non-existent data object will create it by default.\n"
+                 "Writing to an existing data object always truncates it.  Truncation can be\n"
+                 "disabled by passing --no-trunc.  However, using --no-trunc disables creation\n"
+                 "of data objects.\n"
+                 "\n"
+                 "If the client-side of the connection is interrupted before the data object\n"
+                 "is closed, then the catalog will not be updated and the data object will have\n"
+                 "a replica status of intermediate or stale.  Information such as data object\n"
+                 "size and checksum will not be available.\n"
+                 "\n"
+                 "If the target data object does not reside on the connected server, istream\n"
+                 "will not attempt to redirect to the server hosting the replica.  Traffic will\n"
+                 "always flow through the connected server.\n"
+                 "\n"
+                 "Options:\n"
+                 "-R, --resource  The root resource to read from or write to.  Cannot be used\n"
+                 "                with --replica.\n"
+                 "-n, --replica   The replica number of the replica to read from or write to.\n"
+                 "                Replica numbers cannot be used to create new data objects.\n"
+                 "                Cannot be used with --resource.\n"
+                 "-o, --offset    The number of bytes to skip within the data object before\n"
+                 "                reading/writing.  Value must be positive.  Defaults to zero.\n"
+                 "-c, --count     The number of bytes to read/write.  Value must be positive.\n"
+                 "                Defaults to all bytes.\n"
+                 "-a, --append    Appends bytes read from stdin to the data object.  Implies\n"
+                 "                --no-trunc.\n"
+                 "    --no-trunc  Does not truncate the data object.  Disables creation of data\n"
+                 "                objects.  Ignored by write operations when --append is set.\n"
+                 "-k, --checksum  Compute checksum.\n"
+                 "-K, --verify-checksum\n"
+                 "                Compute a SHA-256 checksum on the client while bytes are\n"
+                 "                streamed and verify it against the checksum computed by the\n"
+                 "                server.  Implies --checksum.  If the zone uses a hashing\n"
+                 "                scheme other than SHA-256, the checksum computed by the\n"
+                 "                server is kept and not verified on the client.\n"
+                 "    --register-checksum\n"
+                 "                Compute a SHA-256 checksum on the client while bytes are\n"
+                 "                streamed and register it in the catalog, so the server does\n"
+                 "                not have to read the replica again.  If the catalog update is\n"
+                 "                rejected (e.g. due to insufficient privileges), the server\n"
+                 "                computes the checksum instead.  Cannot be used with -k or -K.\n"
+                 "                Both -K and --register-checksum require writing all bytes of a\n"
+                 "                truncated data object, i.e. no --offset, --count, --no-trunc,\n"
+                 "                --append, or --parallel.\n"
+                 "    --parallel  The number of streams used to transfer bytes.  Each stream\n"
+                 "                uses its own connection and transfers disjoint ranges of the\n"
+                 "                replica.  Reads still write bytes to stdout in order.  Writes\n"
+                 "                require the input to be seekable, i.e. --from or stdin\n"
+                 "                redirected from a regular file.  If a parallel write fails\n"
+                 "                after the replica is opened, the replica is left\n"
+                 "                intermediate so that partial data is never marked good, and\n"
+                 "                an administrator must reset its status (e.g. with 'iadmin\n"
+                 "                modrepl').  Cannot be used with --append.  Defaults to 1, at\n"
+                 "                most 64.\n"
+                 "    --from      Read bytes from FILE instead of stdin.  Only valid for write\n"
+                 "                operations.\n"
+                 "    --ranges    Read the byte ranges listed in FILE (or stdin if FILE is -)\n"
+                 "                over a single stream.  Each line holds an offset and a length\n"
+                 "                separated by whitespace.  Empty lines and lines starting with\n"
+                 "                # are ignored.  Ranges are sorted and overlapping or adjacent\n"
+                 "                ranges are merged.  Each resulting range is written to stdout\n"
+                 "                as a line holding its offset and length, followed by exactly\n"
+                 "                that many bytes.  Ranges extending past the end of the replica\n"
+                 "                are shortened.  Cannot be used with --offset, --count, or\n"
+                 "                --parallel.\n"
+                 "    --batch     Read logical paths from stdin, one per line, and stream the\n"
+                 "                contents of each data object over a single connection.  Each\n"
+                 "                data object is written to stdout as a line holding its size\n"
+                 "                and logical path separated by a space, followed by exactly\n"
+                 "                that many bytes.  A data object that cannot be read is\n"
+                 "                reported on stderr and written as a line holding -1 and its\n"
+                 "                logical path with no bytes following; the remaining paths\n"
+                 "                are still read.  Cannot be used with --offset, --count,\n"
+                 "                --parallel, or --ranges, or with a LOGICAL_PATH argument.\n"
+                 "    --resume-journal\n"
+                 "                Record the number of bytes confirmed by the server in FILE\n"
+                 "                every 64 MiB.  If FILE exists when a write starts, the write\n"
+                 "                resumes where the previous run left off: the replica it\n"
+                 "                wrote to is opened without truncation and the confirmed bytes\n"
+                 "                are skipped in the input.  The input must therefore deliver\n"
+                 "                the same bytes as before.  -R and -n are rejected unless\n"
+                 "                they select the replica recorded in FILE.  FILE is removed\n"
+                 "                once the data object is closed successfully.  Cannot be used\n"
+                 "                with --append, --parallel, -K, or --register-checksum.  Only\n"
+                 "                runs that stop without losing the connection (e.g. a failing\n"
+                 "                input) can be resumed directly.  When the connection is lost,\n"
+                 "                the server leaves the replica locked and an administrator\n"
+                 "                must reset its status before the write can be resumed.  A\n"
+                 "                failure to update FILE stops the write.\n"
+                 "    --buffer-size\n"
+                 "                The number of bytes moved between iRODS and stdin/stdout per\n"
+                 "                operation.  Also the size of each range read by --parallel.\n"
+                 "                Defaults to 4194304 (4 MiB).\n"
+                 "    --splice    When stdout is a pipe, move pages into the pipe using\n"
+                 "                vmsplice instead of copying them.  Each spliced buffer is\n"
+                 "                discarded rather than reused, since the reader may still\n"
+                 "                reference its pages.  Off by default.\n"
+                 "    --stats     Print transfer statistics to stderr once the operation\n"
+                 "                completes.  The value selects the format: human (default) or\n"
+                 "                json.  Reports throughput, connect/open/close latency, time\n"
+                 "                spent busy in network and local I/O (summed across parallel\n"
+                 "                streams), wall-clock time during which any I/O on that side\n"
+                 "                was active (the rest is reported as stalled), and a\n"
+                 "                histogram of per-operation latency.\n"
+                 "-h, --help      Prints this message\n";
+
+    printReleaseInfo("istream");
+}
+
+auto check_input_arguments(const po::variables_map& vm) -> std::tuple<bool, int>
+{
+    if (vm.count("help")) {
+        usage();
+        return {true, 0};
+    }
+
+    const auto is_valid_operation = [](const auto& op)
+    {
+        const auto ops = {"read", "write"};
+        return std::any_of(std::begin(ops), std::end(ops), [&op] (auto&& other_op) {
+            return op == other_op;
+        });
+    };
+
+    if (vm.count("stream_operation") == 0 || !is_valid_operation(vm["stream_operation"].as<std::string>())) {
+        std::cerr << "Error: Missing stream operation.\n";
+        return {true, 1};
+    }
+
+    if (vm["batch"].as<bool>()) {
+        if (vm["stream_operation"].as<std::string>() != "read") {
+            std::cerr << "Error: --batch is only supported by read operations.\n";
+            return {true, 1};
+        }
+
+        if (vm.count("logical_path")) {
+            std::cerr << "Error: --batch reads logical paths from stdin.\n";
+            return {true, 1};
+        }
+
+        if (vm["offset"].as<int_type>() != 0 || vm["count"].as<int_type>() != all_bytes ||
+            vm["parallel"].as<int>() > 1 || vm.count("ranges"))
+        {
+            std::cerr << "Error: --batch cannot be used with --offset, --count, --parallel, or --ranges.\n";
+            return {true, 1};
+        }
+    }
+    else if (vm.count("logical_path") == 0) {
+        std::cerr << "Error: Missing logical path.\n";
+        return {true, 1};
+    }
+
+    if (vm["verify-checksum"].as<bool>() || vm["register-checksum"].as<bool>()) {
+        if (vm["stream_operation"].as<std::string>() != "write") {
+            std::cerr << "Error: Client-side checksums are only supported by write operations.\n";
+            return {true, 1};
+        }
+
+        if (vm["register-checksum"].as<bool>() && (vm["checksum"].as<bool>() || vm["verify-checksum"].as<bool>())) {
+            std::cerr << "Error: --register-checksum cannot be used with --checksum or --verify-checksum.\n";
+            return {true, 1};
+        }
+
+        // The client-side checksum only describes the replica if every byte of it
+        // passes through this process.
+        if (vm["offset"].as<int_type>() != 0 || vm["count"].as<int_type>() != all_bytes ||
+            vm["no-trunc"].as<bool>() || vm["append"].as<bool>() || vm["parallel"].as<int>() > 1)
+        {
+            std::cerr << "Error: Client-side checksums require writing all bytes of a truncated data object.\n";
+            return {true, 1};
+        }
+    }
+
+    if (vm.count("stats")) {
+        if (const auto& format = vm["stats"].as<std::string>(); "human" != format && "json" != format) {
+            std::cerr << "Error: Invalid statistics format [" << format << "].\n";
+            return {true, 1};
+        }
+    }
+
+    if (vm.count("ranges")) {
+        if (vm["stream_operation"].as<std::string>() != "read") {
+            std::cerr << "Error: --ranges is only supported by read operations.\n";
+            return {true, 1};
+        }
+
+        if (vm["offset"].as<int_type>() != 0 || vm["count"].as<int_type>() != all_bytes ||
+            vm["parallel"].as<int>() > 1)
+        {
+            std::cerr << "Error: --ranges cannot be used with --offset, --count, or --parallel.\n";
+            return {true, 1};
+        }
+    }
+
+    if (vm.count("resume-journal")) {
+        if (vm["stream_operation"].as<std::string>() != "write") {
+            std::cerr << "Error: --resume-journal is only supported by write operations.\n";
+            return {true, 1};
+        }
+
+        if (vm["append"].as<bool>() || vm["parallel"].as<int>() > 1 || vm["verify-checksum"].as<bool>() ||
+            vm["register-checksum"].as<bool>())
+        {
+            std::cerr << "Error: --resume-journal cannot be used with --append, --parallel, --verify-checksum, or "
+                         "--register-checksum.\n";
+            return {true, 1};
+        }
+    }
+
+    if (vm.count("from") && vm["stream_operation"].as<std::string>() != "write") {
+        std::cerr << "Error: --from is only supported by write operations.\n";
+        return {true, 1};
+    }
+
+    if (const auto n = vm["buffer-size"].as<int_type>(); n < 1 || n > max_buffer_size) {
+        std::cerr << "Error: Invalid buffer size.\n";
+        return {true, 1};
+    }
+
+    if (const auto n = vm["parallel"].as<int>(); n < 1 || n > utils::max_connections) {
+        std::cerr << "Error: Invalid number of streams (expected 1 to " << utils::max_connections << ").\n";
+        return {true, 1};
+    }
+    else if (n > 1 && vm["append"].as<bool>()) {
+        std::cerr << "Error: --parallel and --append cannot be used together.\n";
+        return {true, 1};
+    }
+
+    return {false, 0};
+}
+
+auto canonical(const std::string& path, rodsEnv& env) -> std::optional<std::string>
+{
+    rodsPath_t input{};
+    rstrcpy(input.inPath, path.data(), MAX_NAME_LEN);
+
+    if (parseRodsPath(&input, &env) != 0) {
+        return std::nullopt;
+    }
+
+    auto* escaped_path = escape_path(input.outPath);
+    std::optional<std::string> p = escaped_path;
+    std::free(escaped_path);
+
+    return p;
+}
+
+template <typename Source, typename Sink>
+auto stream_bytes(Source& in, Sink& out, int_type count, std::size_t buffer_size, sha256_digest* digest) -> int
+{
+    byte_pipeline pipeline{buffer_size};
+    return pipeline.run(in, out, count, digest);
+}
+
+auto read_data_object(rodsEnv& env,
+                      const po::variables_map& vm,
+                      io::client::default_transport& tp,
+                      transfer_stats& stats) -> int
+{
+    if (vm["append"].as<bool>()) {
+        std::cerr << "Error: Invalid option on read: --append\n";
+        return 1;
+    }
+
+    if (vm["no-trunc"].as<bool>()) {
+        std::cerr << "Error: Invalid option on read: --no-trunc.\n";
+        return 1;
+    }
+
+    if (vm["batch"].as<bool>()) {
+        return read_data_object_batch(env, vm, tp, stats);
+    }
+
+    std::string path;
+
+    if (auto v = canonical(vm["logical_path"].as<std::string>(), env); v) {
+        path = *v;
+    }
+    else {
+        std::cerr << "Error: Failed to convert path to absolute path.\n";
+        return 1;
+    }
+
+    std::vector<byte_range> ranges;
+
+    if (vm.count("ranges")) {
+        if (auto r = parse_ranges(vm["ranges"].as<std::string>()); r) {
+            ranges = std::move(*r);
+        }
+        else {
+            return 1;
+        }
+    }
+
+    io::idstream in;
+
+    if (vm.count("resource") && vm.count("replica")) {
+        std::cerr << "Error: --resource and --replica cannot be used together.\n";
+        return 1;
+    }
+
+    const auto open_start = stats_clock::now();
+
+    if (vm.count("resource")) {
+        in.open(tp, path, io::root_resource_name{vm["resource"].as<std::string>()});
+    }
+    else if (vm.count("replica")) {
+        in.open(tp, path, io::replica_number{vm["replica"].as<int>()});
+    }
+    else {
+        in.open(tp, path);
+    }
+
+    stats.open_latency = stats_clock::now() - open_start;
+
+    irods::at_scope_exit close_stream{[&in, &stats] {
+        if (in.is_open()) {
+            const auto close_start = stats_clock::now();
+            in.close();
+            stats.close_latency = stats_clock::now() - close_start;
+        }
+    }};
+
+    if (!in) {
+        std::cerr << "Error: Cannot open data object.\n";
+        return 1;
+    }
+
+    const auto offset = vm["offset"].as<int_type>();
+
+    if (offset < 0) {
+        std::cerr << "Error: Invalid byte offset.\n";
+        return 1;
+    }
+
+    const auto buffer_size = vm["buffer-size"].as<int_type>();
+    auto count = vm["count"].as<int_type>();
+
+    // Reading all bytes only requires streaming until EOF. The replica size is only
+    // needed when the number of bytes to read must be known up front. In that case,
+    // it is obtained by seeking the open stream rather than by querying the catalog.
+    const auto size_required = vm.count("ranges") || vm["parallel"].as<int>() > 1 || all_bytes != count;
+    std::optional<int_type> replica_size;
+
+    if (size_required) {
+        replica_size = stream_size(in);
+
+        if (!replica_size) {
+            std::cerr << "Error: Could not determine size of replica.\n";
+            return 1;
+        }
+    }
+
+    if (vm.count("ranges")) {
+        return read_data_object_ranges(in, ranges, *replica_size, buffer_size, stats);
+    }
+
+    if (!in.seekg(offset)) {
+        std::cerr << "Error: Could not seek to offset.\n";
+        return 1;
+    }
+
+    if (replica_size) {
+        count = std::min<int_type>(std::max<int_type>(*replica_size - offset, 0), count);
+    }
+
+    if (const auto n_streams = vm["parallel"].as<int>(); n_streams > 1) {
+        return read_data_object_parallel(path, in, offset, count, n_streams, buffer_size, stats);
+    }
+
+    dstream_source source{in};
+    stdout_sink sink{vm["splice"].as<bool>()};
+    timed_source timed_in{source, stats.network};
+    timed_sink timed_out{sink, stats.local};
+
+    if (const auto ec = stream_bytes(timed_in, timed_out, count, buffer_size); ec) {
+        return ec;
+    }
+
+    return 0;
+}
+
+auto stream_size(io::idstream& in) -> std::optional<int_type>
+{
+    const auto size = in.rdbuf()->pubseekoff(0, std::ios_base::end, std::ios_base::in);
+
+    if (size < 0) {
+        return std::nullopt;
+    }
+
+    return static_cast<int_type>(size);
+}
+
+auto read_data_object_parallel(const std::string& path,
+                               io::idstream& in,
+                               int_type offset,
+                               int_type count,
+                               int n_streams,
+                               std::size_t buffer_size,
+                               transfer_stats& stats) -> int
+{
+    if (count < 0) {
+        std::cerr << "Error: Invalid byte count.\n";
+        return 1;
+    }
+
+    const auto chunk_size = static_cast<int_type>(buffer_size);
+    const auto n_chunks = static_cast<std::size_t>((count + chunk_size - 1) / chunk_size);
+
+    // Each stream reads every n-th chunk of the requested range. Letting every stream
+    // have two chunks outstanding keeps all connections busy while the writer drains
+    // the buffer.
+    reorder_buffer chunks{2 * static_cast<std::size_t>(n_streams)};
+
+    const auto read_chunks = [&chunks, &stats, offset, count, chunk_size, n_chunks, n_streams](io::idstream& stream,
+                                                                                                std::size_t first) {
+        try {
+            for (auto i = first; i < n_chunks; i += n_streams) {
+                if (!chunks.wait_for_slot(i)) {
+                    return;
+                }
+
+                const auto chunk_offset = static_cast<int_type>(i) * chunk_size;
+                std::vector<char> chunk(std::min<int_type>(chunk_size, count - chunk_offset));
+
+                const auto [ok, d] = stats.network.timed([&] {
+                    return stream.seekg(offset + chunk_offset) && stream.read(chunk.data(), chunk.size());
+                });
+
+                if (!ok) {
+                    chunks.fail("Failed to read requested number of bytes.");
+                    return;
+                }
+
+                stats.network.record(chunk.size(), d);
+
+                chunks.put(i, std::move(chunk));
+            }
+        }
+        catch (const std::exception& e) {
+            chunks.fail(e.what());
+        }
+    };
+
+    // The additional connections are established serially so that client-side
+    // authentication is never run concurrently.
+    struct stream_context
+    {
+        irods::experimental::client_connection conn;
+        io::client::default_transport tp{conn};
+        io::idstream in;
+    };
+
+    std::vector<std::unique_ptr<stream_context>> contexts;
+
+    for (int i = 1; i < n_streams; ++i) {
+        auto& ctx = contexts.emplace_back(std::make_unique<stream_context>());
+
+        // Every stream must read the replica selected by the primary stream.
+        ctx->in.open(ctx->tp, path, io::replica_number{in.replica_number().value});
+
+        if (!ctx->in) {
+            std::cerr << "Error: Cannot open data object.\n";
+            return 1;
+        }
+    }
+
+    std::vector<std::thread> readers;
+    readers.reserve(n_streams);
+
+    readers.emplace_back(read_chunks, std::ref(in), 0);
+
+    for (std::size_t i = 0; i < contexts.size(); ++i) {
+        readers.emplace_back(read_chunks, std::ref(contexts[i]->in), i + 1);
+    }
+
+    irods::at_scope_exit join_readers{[&readers] {
+        for (auto&& t : readers) {
+            t.join();
+        }
+    }};
+
+    // Chunks are freed as soon as they are written, so they are never spliced into a pipe.
+    stdout_sink sink{false};
+
+    for (std::size_t i = 0; i < n_chunks; ++i) {
+        auto chunk = chunks.take_next();
+
+        if (!chunk) {
+            std::cerr << "Error: " << chunks.error() << '\n';
+            return 1;
+        }
+
+        const auto [ok, d] = stats.local.timed([&] { return sink.write(chunk->data(), chunk->size()); });
+        stats.local.record(chunk->size(), d);
+
+        if (!ok) {
+            chunks.fail("Failed to write bytes to stdout.");
+            std::cerr << "Error: Failed to write requested number of bytes to stdout.\n";
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+auto parse_ranges(const std::string& file) -> std::optional<std::vector<byte_range>>
+{
+    std::ifstream file_in;
+    std::istream* in = &std::cin;
+
+    if ("-" != file) {
+        file_in.open(file);
+
+        if (!file_in) {
+            std::cerr << "Error: Cannot open file [" << file << "].\n";
+            return std::nullopt;
+        }
+
+        in = &file_in;
+    }
+
+    std::vector<byte_range> ranges;
+    std::string line;
+
+    for (int line_number = 1; std::getline(*in, line); ++line_number) {
+        std::istringstream ss{line};
+        std::string token;
+
+        if (!(ss >> token) || '#' == token[0]) {
+            continue;
+        }
+
+        byte_range r{};
+        ss.clear();
+        ss.seekg(0);
+
+        // Ranges extending past the largest representable offset are rejected so that the
+        // end of every range can be computed without overflow.
+        if (!(ss >> r.offset >> r.length) || !(ss >> std::ws).eof() || r.offset < 0 || r.length < 0 ||
+            r.length > std::numeric_limits<int_type>::max() - r.offset)
+        {
+            std::cerr << "Error: Invalid byte range on line " << line_number << " of [" << file << "].\n";
+            return std::nullopt;
+        }
+
+        if (r.length > 0) {
+            ranges.push_back(r);
+        }
+    }
+
+    // Sorting and merging keeps the stream moving forward and avoids a seek (and its
+    // round trip) for every range that touches the previous one.
+    std::sort(std::begin(ranges), std::end(ranges), [](const auto& a, const auto& b) { return a.offset < b.offset; });
+
+    std::vector<byte_range> merged;
+
+    for (const auto& r : ranges) {
+        if (!merged.empty() && r.offset <= merged.back().offset + merged.back().length) {
+            auto& last = merged.back();
+            last.length = std::max(last.offset + last.length, r.offset + r.length) - last.offset;
+        }
+        else {
+            merged.push_back(r);
+        }
+    }
+
+    return merged;
+}
+
+auto read_data_object_ranges(io::idstream& in,
+                             const std::vector<byte_range>& ranges,
+                             int_type replica_size,
+                             std::size_t buffer_size,
+                             transfer_stats& stats) -> int
+{
+    stdout_sink stdout_out{false};
+    timed_sink sink{stdout_out, stats.local};
+    std::vector<char> buf(buffer_size);
+    int_type position = -1;
+
+    for (const auto& r : ranges) {
+        const auto length = std::clamp<int_type>(replica_size - r.offset, 0, r.length);
+        const auto header = std::to_string(r.offset) + ' ' + std::to_string(length) + '\n';
+
+        if (!sink.write(header.data(), header.size())) {
+            std::cerr << "Error: Failed to write bytes to stdout.\n";
+            return 1;
+        }
+
+        if (0 == length) {
+            continue;
+        }
+
+        if (position != r.offset && !in.seekg(r.offset)) {
+            std::cerr << "Error: Could not seek to offset.\n";
+            return 1;
+        }
+
+        for (int_type remaining = length; remaining > 0;) {
+            const auto n = std::min<int_type>(buf.size(), remaining);
+            const auto [ok, d] = stats.network.timed([&] { return static_cast<bool>(in.read(buf.data(), n)); });
+
+            if (!ok) {
+                std::cerr << "Error: Failed to read requested number of bytes.\n";
+                return 1;
+            }
+
+            stats.network.record(in.gcount(), d);
+
+            if (!sink.write(buf.data(), in.gcount())) {
+                std::cerr << "Error: Failed to write bytes to stdout.\n";
+                return 1;
+            }
+
+            remaining -= in.gcount();
+        }
+
+        position = r.offset + length;
     }
 
     return 0;
 }
 
-auto write_data_object(rodsEnv& env, const po::variables_map& vm, io::client::default_transport& tp) -> int
+auto read_data_object_batch(rodsEnv& env,
+                            const po::variables_map& vm,
+                            io::client::default_transport& tp,
+                            transfer_stats& stats) -> int
+{
+    if (vm.count("resource") && vm.count("replica")) {
+        std::cerr << "Error: --resource and --replica cannot be used together.\n";
+        return 1;
+    }
+
+    const auto buffer_size = vm["buffer-size"].as<int_type>();
+
+    // Every data object is written through the same sink and pipeline.
+    stdout_sink sink{vm["splice"].as<bool>()};
+    timed_sink timed_out{sink, stats.local};
+    byte_pipeline pipeline{static_cast<std::size_t>(buffer_size)};
+
+    int ec = 0;
+    std::string line;
+
+    while (std::getline(std::cin, line)) {
+        if (line.empty()) {
+            continue;
+        }
+
+        // The header is a temporary, so it must be copied into the pipe even when data
+        // is spliced.
+        const auto write_header = [&sink, &line](int_type size) {
+            const auto header = std::to_string(size) + ' ' + line + '\n';
+            return sink.write_copy(header.data(), header.size());
+        };
+
+        const auto report_failure = [&ec, &write_header, &line](const char* msg) {
+            std::cerr << "Error: " << msg << " [" << line << "]\n";
+            ec = 1;
+            return write_header(-1);
+        };
+
+        const auto path = canonical(line, env);
+
+        if (!path) {
+            if (!report_failure("Failed to convert path to absolute path.")) {
+                break;
+            }
+
+            continue;
+        }
+
+        io::idstream in;
+
+        const auto open_start = stats_clock::now();
+
+        if (vm.count("resource")) {
+            in.open(tp, *path, io::root_resource_name{vm["resource"].as<std::string>()});
+        }
+        else if (vm.count("replica")) {
+            in.open(tp, *path, io::replica_number{vm["replica"].as<int>()});
+        }
+        else {
+            in.open(tp, *path);
+        }
+
+        stats.open_latency += stats_clock::now() - open_start;
+
+        if (!in) {
+            if (!report_failure("Cannot open data object.")) {
+                break;
+            }
+
+            continue;
+        }
+
+        const auto size = stream_size(in);
+
+        if (!size || !in.seekg(0)) {
+            if (!report_failure("Could not determine size of replica.")) {
+                break;
+            }
+
+            continue;
+        }
+
+        if (!write_header(*size)) {
+            std::cerr << "Error: Failed to write bytes to stdout.\n";
+            return 1;
+        }
+
+        if (*size > 0) {
+            dstream_source source{in};
+            timed_source timed_in{source, stats.network};
+
+            // The header has already been written, so a short read cannot be recovered
+            // from without corrupting the framing of the remaining data objects.
+            if (const auto e = pipeline.run(timed_in, timed_out, *size, nullptr); e) {
+                return e;
+            }
+        }
+
+        const auto close_start = stats_clock::now();
+        in.close();
+        stats.close_latency += stats_clock::now() - close_start;
+    }
+
+    return ec;
+}
+
+auto write_data_object(rodsEnv& env,
+                       const po::variables_map& vm,
+                       irods::experimental::client_connection& conn,
+                       io::client::default_transport& tp,
+                       transfer_stats& stats) -> int
 {
     auto mode = std::ios_base::out;
 
@@ -349,14 +1964,92 @@ auto write_data_object(rodsEnv& env, const po::variables_map& vm, io::client::de
         return 1;
     }
 
+    const auto offset = vm["offset"].as<int_type>();
+
+    if (offset < 0) {
+        std::cerr << "Error: Invalid byte offset.\n";
+        return 1;
+    }
+
+    std::optional<progress_journal> journal;
+
+    if (vm.count("resume-journal")) {
+        journal.emplace(vm["resume-journal"].as<std::string>(), path, offset);
+
+        if (!journal->load()) {
+            return 1;
+        }
+
+        // The bytes written by previous runs must not be truncated.
+        if (journal->resuming()) {
+            mode = std::ios_base::out | std::ios_base::in;
+        }
+    }
+
+    if (vm.count("resource") && vm.count("replica")) {
+        std::cerr << "Error: --resource and --replica cannot be used together.\n";
+        return 1;
+    }
+
+    int fd = STDIN_FILENO;
+
+    if (vm.count("from")) {
+        fd = ::open(vm["from"].as<std::string>().c_str(), O_RDONLY);
+
+        if (fd < 0) {
+            std::cerr << "Error: Cannot open file [" << vm["from"].as<std::string>() << "].\n";
+            return 1;
+        }
+    }
+
+    irods::at_scope_exit close_input{[fd] {
+        if (STDIN_FILENO != fd) {
+            ::close(fd);
+        }
+    }};
+
+    const auto n_streams = vm["parallel"].as<int>();
+    auto count = vm["count"].as<int_type>();
+
+    // The input is checked before the replica is opened, so that a bad input does not
+    // truncate the replica or leave it locked (see write_data_object_parallel).
+    if (n_streams > 1) {
+        if (const auto n = parallel_write_size(fd, count); n) {
+            count = *n;
+        }
+        else {
+            return 1;
+        }
+    }
+
     io::odstream out;
-    
-    if (vm.count("resource")) {
-        if (vm.count("replica")) {
-            std::cerr << "Error: --resource and --replica cannot be used together.\n";
+
+    // A resumed write must continue the replica that holds the bytes already written.
+    // -R and -n are only accepted when they select that replica.
+    if (journal && journal->resuming()) {
+        const auto replica_number = *journal->replica_number();
+
+        if (vm.count("replica") && vm["replica"].as<int>() != replica_number) {
+            std::cerr << "Error: Cannot resume. The journal was written for replica " << replica_number
+                      << ", not replica " << vm["replica"].as<int>() << ".\n";
+            return 1;
+        }
+
+        if (vm.count("resource") &&
+            !replica_in_resource(*static_cast<rcComm_t*>(conn), path, replica_number, vm["resource"].as<std::string>()))
+        {
+            std::cerr << "Error: Cannot resume. The journal was written for replica " << replica_number
+                      << ", which is not in resource [" << vm["resource"].as<std::string>() << "].\n";
             return 1;
         }
+    }
+
+    const auto open_start = stats_clock::now();
 
+    if (journal && journal->resuming()) {
+        out.open(tp, path, io::replica_number{*journal->replica_number()}, mode);
+    }
+    else if (vm.count("resource")) {
         out.open(tp, path, io::root_resource_name{vm["resource"].as<std::string>()}, mode);
     }
     else if (vm.count("replica")) {
@@ -369,32 +2062,500 @@ auto write_data_object(rodsEnv& env, const po::variables_map& vm, io::client::de
         out.open(tp, path, mode);
     }
 
+    stats.open_latency = stats_clock::now() - open_start;
+
     if (!out) {
+        // A run interrupted by a lost connection leaves the replica locked until an
+        // administrator resolves it, which prevents it from being reopened.
+        if (journal && journal->resuming() &&
+            replica_locked(*static_cast<rcComm_t*>(conn), path, *journal->replica_number()))
+        {
+            std::cerr << "Error: Cannot resume. Replica " << *journal->replica_number()
+                      << " is still locked by the interrupted transfer. An administrator must reset its status "
+                         "(e.g. with 'iadmin modrepl') before the write can be resumed.\n";
+            return 1;
+        }
+
         std::cerr << "Error: Cannot open data object.\n";
         return 1;
     }
 
-    if (const auto offset = vm["offset"].as<int_type>(); offset >= 0) {
-        if (!out.seekp(offset)) {
-            std::cerr << "Error: Could not seek to offset.\n";
+    const auto bytes_written = journal ? journal->bytes_written() : 0;
+
+    if (!out.seekp(offset + bytes_written)) {
+        std::cerr << "Error: Could not seek to offset.\n";
+        return 1;
+    }
+
+    const auto buffer_size = vm["buffer-size"].as<int_type>();
+
+    if (journal) {
+        if (!journal->begin(out.replica_number().value)) {
+            std::cerr << "Error: Cannot write journal [" << vm["resume-journal"].as<std::string>() << "].\n";
             return 1;
         }
+
+        if (bytes_written > 0) {
+            if (all_bytes != count) {
+                count = std::max<int_type>(count - bytes_written, 0);
+            }
+
+            if (!skip_input(fd, bytes_written, buffer_size)) {
+                std::cerr << "Error: Could not skip bytes already written to the data object.\n";
+                return 1;
+            }
+        }
+    }
+
+    std::unique_ptr<sha256_digest> digest;
+
+    if (vm["verify-checksum"].as<bool>() || vm["register-checksum"].as<bool>()) {
+        digest = std::make_unique<sha256_digest>();
+    }
+
+    if (n_streams > 1) {
+        if (const auto ec = write_data_object_parallel(path, out, fd, offset, count, n_streams, buffer_size, stats);
+            ec) {
+            return ec;
+        }
     }
     else {
-        std::cerr << "Error: Invalid byte offset.\n";
-        return 1;
+        fd_source source{fd};
+        dstream_sink sink{out, journal ? &*journal : nullptr};
+        timed_source timed_in{source, stats.local};
+        timed_sink timed_out{sink, stats.network};
+
+        if (const auto ec = stream_bytes(timed_in, timed_out, count, buffer_size, digest.get()); ec) {
+            return ec;
+        }
     }
 
-    if (const auto ec = stream_bytes(std::cin, out, vm["count"].as<int_type>()); ec) {
-        return ec;
+    if (!out) {
+        return 0;
     }
 
-    if (vm["checksum"].as<bool>() && out) {
+    const auto replica_number = out.replica_number().value;
+    const auto close_start = stats_clock::now();
+
+    if (vm["checksum"].as<bool>() || vm["verify-checksum"].as<bool>()) {
         io::on_close_success input;
         input.compute_checksum = true;
         out.close(&input);
     }
+    else {
+        out.close();
+    }
+
+    stats.close_latency = stats_clock::now() - close_start;
+
+    if (journal) {
+        journal->remove();
+    }
+
+    if (!digest) {
+        return 0;
+    }
+
+    const auto client_checksum = digest->checksum();
+
+    if (vm["register-checksum"].as<bool>()) {
+        return register_checksum(conn, path, replica_number, client_checksum);
+    }
+
+    const auto server_checksum = ir::replica_checksum<RcComm>(conn, path, replica_number);
+
+    if (server_checksum.empty()) {
+        std::cerr << "Error: Server did not compute a checksum.\n";
+        return 1;
+    }
+
+    // The client only computes SHA-256. When the zone uses another hashing scheme (e.g.
+    // MD5), the checksum computed by the server while closing the replica is kept.
+    if (!server_checksum.starts_with("sha2:")) {
+        std::cerr << "Warning: The server does not use SHA-256 checksums. Skipping client-side verification.\n";
+        return 0;
+    }
+
+    if (server_checksum != client_checksum) {
+        std::cerr << "Error: Checksum mismatch [client=" << client_checksum << ", server=" << server_checksum << "].\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+auto register_checksum(irods::experimental::client_connection& conn,
+                       const std::string& path,
+                       int replica_number,
+                       const std::string& checksum) -> int
+{
+    keyValPair_t reg_params{};
+    irods::at_scope_exit free_reg_params{[&reg_params] { clearKeyVal(&reg_params); }};
+    addKeyVal(&reg_params, CHKSUM_KW, checksum.c_str());
+
+    dataObjInfo_t info{};
+    rstrcpy(info.objPath, path.c_str(), MAX_NAME_LEN);
+    info.replNum = replica_number;
+
+    modDataObjMeta_t input{};
+    input.dataObjInfo = &info;
+    input.regParam = &reg_params;
+
+    if (const auto ec = rc_data_object_modify_info(static_cast<rcComm_t*>(conn), &input); ec < 0) {
+        std::cerr << "Warning: Could not register client-side checksum [ec=" << ec
+                  << "]. Computing checksum on the server.\n";
+
+        try {
+            if (ir::replica_checksum<RcComm>(conn, path, replica_number).empty()) {
+                std::cerr << "Error: Server did not compute a checksum.\n";
+                return 1;
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: Could not compute checksum on the server: " << e.what() << '\n';
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+auto parallel_write_size(int fd, int_type count) -> std::optional<int_type>
+{
+    struct stat st{};
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        std::cerr << "Error: --parallel requires the input to be a regular file.\n";
+        return std::nullopt;
+    }
+
+    // Bytes are read starting at the current position of the input, which allows
+    // callers to skip a prefix of stdin before invoking istream.
+    const auto input_offset = static_cast<int_type>(lseek(fd, 0, SEEK_CUR));
+
+    if (input_offset < 0) {
+        std::cerr << "Error: Could not determine position of input.\n";
+        return std::nullopt;
+    }
+
+    const auto bytes_available = std::max<int_type>(st.st_size - input_offset, 0);
+
+    if (all_bytes == count) {
+        return bytes_available;
+    }
+
+    if (count < 0) {
+        std::cerr << "Error: Invalid byte count.\n";
+        return std::nullopt;
+    }
+
+    if (count > bytes_available) {
+        std::cerr << "Error: Failed to read requested number of bytes.\n";
+        return std::nullopt;
+    }
+
+    return count;
+}
+
+// Writes count bytes, already checked by parallel_write_size, over n_streams streams. Once
+// the replica is open, every failure, including an exception while connecting the
+// additional streams, leaves the replica intermediate: the primary stream is closed
+// without updating the size or status, so partially written bytes are never marked good.
+auto write_data_object_parallel(const std::string& path,
+                                io::odstream& out,
+                                int fd,
+                                int_type offset,
+                                int_type count,
+                                int n_streams,
+                                std::size_t buffer_size,
+                                transfer_stats& stats) -> int
+{
+    // The additional streams share the primary stream's replica access token. This
+    // allows them to write to the same replica without triggering the replica state
+    // transitions (and catalog updates) reserved for the last stream to close. The
+    // connections are established serially so that client-side authentication is
+    // never run concurrently.
+    struct stream_context
+    {
+        irods::experimental::client_connection conn;
+        io::client::default_transport tp{conn};
+        io::odstream out;
+    };
+
+    std::vector<std::unique_ptr<stream_context>> contexts;
+
+    // Secondary streams must be closed before the primary stream. They must not update
+    // the catalog, as that is the job of the primary stream. Letting their destructors
+    // close them would finalize the replica, so they are always closed explicitly.
+    io::on_close_success close_input;
+    close_input.update_size = false;
+    close_input.update_status = false;
+    close_input.compute_checksum = false;
+    close_input.send_notifications = false;
+    close_input.preserve_replica_state_table = true;
+
+    const auto close_secondary_streams = [&contexts, &close_input] {
+        for (auto&& ctx : contexts) {
+            if (ctx->out.is_open()) {
+                ctx->out.close(&close_input);
+            }
+        }
+    };
+
+    irods::at_scope_exit close_secondary_streams_on_exit{close_secondary_streams};
+
+    const auto fail = [&out, &close_secondary_streams](const std::string& msg) {
+        close_secondary_streams();
+
+        std::cerr << "Error: " << msg << '\n';
+
+        if (out.is_open()) {
+            const auto replica_number = out.replica_number().value;
+
+            io::on_close_success abort_input;
+            abort_input.update_size = false;
+            abort_input.update_status = false;
+            abort_input.compute_checksum = false;
+            abort_input.send_notifications = false;
+            out.close(&abort_input);
+
+            std::cerr << "Error: Replica " << replica_number
+                      << " was left intermediate. An administrator must reset its status (e.g. with "
+                         "'iadmin modrepl') before the data object can be written again.\n";
+        }
+
+        return 1;
+    };
+
+    try {
+        // Bytes are read starting at the current position of the input.
+        const auto input_offset = static_cast<int_type>(lseek(fd, 0, SEEK_CUR));
+
+        if (input_offset < 0) {
+            return fail("Could not determine position of input.");
+        }
+
+        // Each stream writes one contiguous range. Ranges are multiples of the buffer size
+        // so that every write except the last one of each stream is a full buffer.
+        const auto chunk_size = static_cast<int_type>(buffer_size);
+        const auto n_chunks = (count + chunk_size - 1) / chunk_size;
+        n_streams = static_cast<int>(std::clamp<int_type>(n_chunks, 1, n_streams));
+        const auto range_size = (n_chunks + n_streams - 1) / n_streams * chunk_size;
+
+        const auto write_range = [&stats, fd, offset, input_offset, count, range_size, buffer_size](
+                                     io::odstream& stream, int i) -> std::string {
+            try {
+                const auto range_offset = i * range_size;
+                const auto range_end = std::min(count, range_offset + range_size);
+
+                if (!stream.seekp(offset + range_offset)) {
+                    return "Could not seek to offset.";
+                }
+
+                std::vector<char> buf(buffer_size);
+
+                for (auto pos = range_offset; pos < range_end;) {
+                    const auto [n, read_time] = stats.local.timed([&] {
+                        const auto n_bytes = std::min<int_type>(buf.size(), range_end - pos);
+                        return pread(fd, buf.data(), n_bytes, input_offset + pos);
+                    });
+
+                    if (n < 0 && EINTR == errno) {
+                        continue;
+                    }
+
+                    if (n <= 0) {
+                        return "Failed to read requested number of bytes.";
+                    }
+
+                    stats.local.record(n, read_time);
+
+                    const auto [ok, write_time] =
+                        stats.network.timed([&] { return static_cast<bool>(stream.write(buf.data(), n)); });
+
+                    if (!ok) {
+                        return "Failed to write requested number of bytes to data object.";
+                    }
+
+                    stats.network.record(n, write_time);
+
+                    pos += n;
+                }
+
+                if (!stream.flush()) {
+                    return "Failed to write requested number of bytes to data object.";
+                }
+            }
+            catch (const std::exception& e) {
+                return e.what();
+            }
+
+            return {};
+        };
+
+        for (int i = 1; i < n_streams; ++i) {
+            auto& ctx = contexts.emplace_back(std::make_unique<stream_context>());
+
+            const auto mode = std::ios_base::in | std::ios_base::out;
+            ctx->out.open(ctx->tp, out.replica_token(), path, out.leaf_resource_name(), mode);
+
+            if (!ctx->out) {
+                return fail("Cannot open data object.");
+            }
+        }
+
+        std::vector<std::string> errors(n_streams);
+        std::vector<std::thread> writers;
+        writers.reserve(contexts.size());
+
+        {
+            // Joins the writers started so far if starting another one throws.
+            irods::at_scope_exit join_writers{[&writers] {
+                for (auto&& t : writers) {
+                    if (t.joinable()) {
+                        t.join();
+                    }
+                }
+            }};
+
+            for (std::size_t i = 0; i < contexts.size(); ++i) {
+                writers.emplace_back([&, i] { errors[i + 1] = write_range(contexts[i]->out, i + 1); });
+            }
+
+            errors[0] = write_range(out, 0);
+        }
+
+        if (const auto e = std::find_if(std::begin(errors), std::end(errors), [](auto&& e) { return !e.empty(); });
+            e != std::end(errors))
+        {
+            return fail(*e);
+        }
+    }
+    catch (const std::exception& e) {
+        return fail(e.what());
+    }
+
+    close_secondary_streams();
 
     return 0;
 }
 
+auto skip_input(int fd, int_type n, std::size_t buffer_size) -> bool
+{
+    struct stat st{};
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        return lseek(fd, n, SEEK_CUR) >= 0;
+    }
+
+    // Pipes cannot seek, so the bytes are read and discarded.
+    fd_source source{fd};
+    std::vector<char> buf(buffer_size);
+
+    while (n > 0) {
+        const auto bytes_read = source.read(buf.data(), std::min<int_type>(buf.size(), n));
+
+        if (bytes_read <= 0) {
+            return false;
+        }
+
+        n -= bytes_read;
+    }
+
+    return true;
+}
+
+auto replica_locked(rcComm_t& comm, const std::string& path, int replica_number) -> bool
+{
+    const auto slash = path.find_last_of('/');
+    const auto query_string = "select DATA_REPL_STATUS where COLL_NAME = '" + path.substr(0, slash) +
+                              "' and DATA_NAME = '" + path.substr(slash + 1) + "' and DATA_REPL_NUM = '" +
+                              std::to_string(replica_number) + "'";
+
+    try {
+        for (auto&& row : irods::query<rcComm_t>{&comm, query_string}) {
+            const auto status = std::stoi(row[0]);
+            return INTERMEDIATE_REPLICA == status || READ_LOCKED == status || WRITE_LOCKED == status;
+        }
+    }
+    catch (const std::exception&) {
+        // The caller reports the original failure.
+    }
+
+    return false;
+}
+
+auto replica_in_resource(rcComm_t& comm, const std::string& path, int replica_number, const std::string& resource)
+    -> bool
+{
+    const auto slash = path.find_last_of('/');
+    const auto query_string = "select DATA_RESC_HIER where COLL_NAME = '" + path.substr(0, slash) +
+                              "' and DATA_NAME = '" + path.substr(slash + 1) + "' and DATA_REPL_NUM = '" +
+                              std::to_string(replica_number) + "'";
+
+    try {
+        for (auto&& row : irods::query<rcComm_t>{&comm, query_string}) {
+            // -R names the root of the hierarchy.
+            const std::string_view hierarchy = row[0];
+            return hierarchy == resource || hierarchy.starts_with(resource + ';');
+        }
+    }
+    catch (const std::exception&) {
+        // Treated as not matching, so the write is not resumed.
+    }
+
+    return false;
+}
+
+auto print_stats(const transfer_stats& stats, const std::string& format) -> void
+{
+    const auto elapsed = seconds{stats_clock::now() - stats.start};
+    const auto bytes = stats.network.bytes();
+    const auto throughput = elapsed.count() > 0 ? bytes / elapsed.count() : 0.0;
+
+    const nlohmann::json j{{"elapsed_seconds", elapsed.count()},
+                           {"bytes", bytes},
+                           {"bytes_per_second", throughput},
+                           {"connect_latency_seconds", stats.connect_latency.count()},
+                           {"open_latency_seconds", stats.open_latency.count()},
+                           {"close_latency_seconds", stats.close_latency.count()},
+                           {"network", stats.network.to_json(elapsed)},
+                           {"local", stats.local.to_json(elapsed)}};
+
+    if ("json" == format) {
+        std::cerr << j.dump() << '\n';
+        return;
+    }
+
+    constexpr auto mib = 1024.0 * 1024.0;
+
+    std::cerr << "Bytes transferred: " << bytes << '\n'
+              << "Elapsed time:      " << elapsed.count() << " s\n"
+              << "Throughput:        " << throughput / mib << " MiB/s\n"
+              << "Connect latency:   " << stats.connect_latency.count() * 1000 << " ms\n"
+              << "Open latency:      " << stats.open_latency.count() * 1000 << " ms\n"
+              << "Close latency:     " << stats.close_latency.count() * 1000 << " ms\n";
+
+    for (const auto* side : {"network", "local"}) {
+        const auto& s = j.at(side);
+
+        std::cerr << '\n'
+                  << (std::string_view{"network"} == side ? "Network I/O" : "Local I/O") << ":\n"
+                  << "  Operations: " << s.at("operations").get<std::uint64_t>() << '\n'
+                  << "  Busy:       " << s.at("busy_seconds").get<double>() << " s\n"
+                  << "  Active:     " << s.at("active_seconds").get<double>() << " s\n"
+                  << "  Stalled:    " << s.at("stalled_seconds").get<double>() << " s\n"
+                  << "  Latency histogram:\n";
+
+        for (const auto& bucket : s.at("latency_histogram")) {
+            if (bucket.contains("upper_bound_microseconds")) {
+                std::cerr << "    < " << bucket.at("upper_bound_microseconds").get<std::uint64_t>() << " us: ";
+            }
+            else {
+                std::cerr << "    longer: ";
+            }
+
+            std::cerr << bucket.at("count").get<std::uint64_t>() << '\n';
+        }
+    }
+}
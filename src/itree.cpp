@@ -4,19 +4,33 @@
 #include <irods/irods_pack_table.hpp>
 #include <irods/irods_parse_command_line_options.hpp>
 #include <irods/filesystem.hpp>
+#include <irods/irods_query.hpp>
 #include <irods/rcMisc.h>
 #include <irods/rodsPath.h>
 
+#include "collection_walker.hpp"
+#include "utility.hpp"
+
 #include <fmt/core.h>
 #include <fmt/color.h>
 
 #include <boost/program_options.hpp>
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <regex>
 #include <stdexcept>
 #include <string>
+#include <tuple>
+#include <unordered_map>
 #include <variant>
+#include <vector>
 
 #include <fnmatch.h>
 
@@ -30,14 +44,83 @@ using pattern_matcher = std::variant<int,               // no option specified
                                      std::string,       // glob-style pattern specified
                                      std::regex>;       // regex-style pattern specified
 
+// A single permission granted on a collection or data object.
+struct acl_entry
+{
+    std::string name;
+    std::string zone;
+    std::string access_level;
+    std::string type;
+};
+
+// Permissions keyed by the logical path of the collection or data object they apply to.
+using acl_map = std::unordered_map<std::string, std::vector<acl_entry>>;
+
+// A collection or data object within a listing. Entries are built from a collection_iterator
+// or directly from catalog query results. Permissions are only attached when --acl or
+// --owner is used.
+class tree_entry
+{
+  public:
+    tree_entry(fs::path path, bool is_collection, std::uintmax_t data_size)
+        : path_{std::move(path)}
+        , is_collection_{is_collection}
+        , data_size_{data_size}
+    {
+    }
+
+    tree_entry(const fs::client::collection_entry& e) // NOLINT(google-explicit-constructor)
+        : tree_entry{e.path(), e.is_collection(), e.data_size()}
+    {
+    }
+
+    auto path() const -> const fs::path& { return path_; }
+    auto is_collection() const -> bool { return is_collection_; }
+    auto is_data_object() const -> bool { return !is_collection_; }
+    auto data_size() const -> std::uintmax_t { return data_size_; }
+    auto acl() const -> const std::vector<acl_entry>& { return acl_; }
+
+    // Attaches the permissions found for this entry, if any.
+    auto attach_acl(acl_map& acls) -> void
+    {
+        if (auto it = acls.find(path_.string()); it != std::end(acls)) {
+            acl_ = std::move(it->second);
+        }
+    }
+
+  private:
+    fs::path path_;
+    bool is_collection_;
+    std::uintmax_t data_size_;
+    std::vector<acl_entry> acl_;
+}; // class tree_entry
+
+using entry_visitor = std::function<void(const tree_entry&)>;
+
+// Invokes the visitor for each entry of a collection. The second argument is the depth of
+// the collection relative to the collection being rendered.
+using collection_lister = std::function<void(const fs::path&, int, const entry_visitor&)>;
+
 auto print_dir(const fs::path&,
                const po::variables_map&,
                irods::experimental::client_connection&) -> void;
+auto print_tree(const fs::path&,
+                const po::variables_map&,
+                const collection_lister&) -> void;
 // clang-format on
 
 auto correct_path(const po::variables_map&, rodsEnv&) -> fs::path;
 auto print_usage() -> void;
-auto get_json(const fs::path&, const po::variables_map&, ix::client_connection&, unsigned int depth) -> json::json;
+auto list_collection(ix::client_connection&, const fs::path&, fs::client::collection_options, const entry_visitor&)
+    -> void;
+auto glob_to_like(const std::string& glob) -> std::optional<std::string>;
+auto parent_collection(const std::string& path) -> std::string;
+auto load_users(ix::client_connection&, std::vector<std::string> ids) -> void;
+auto query_acls(ix::client_connection&, const std::string& data_condition, const std::string& coll_condition)
+    -> acl_map;
+auto print_json(const tree_entry&, const po::variables_map&, const collection_lister&) -> void;
+auto print_disk_usage(ix::client_connection&, const fs::path&, const po::variables_map&) -> void;
+auto print_ndjson(const tree_entry&, const po::variables_map&, const collection_lister&) -> void;
 auto contains_pattern(const pattern_matcher& pm) -> bool;
 
 // ANSI escape numbers. For setting the colors.
@@ -48,6 +131,94 @@ static pattern_matcher matcher;
 static pattern_matcher exclude_matcher;
 static unsigned int collections = 0, objects = 0;
 static std::uintmax_t total_size = 0;
+// GenQuery conditions on DATA_NAME equivalent to the glob patterns. When set, collections are
+// listed with catalog queries so that only matching data objects are transferred.
+static std::string data_name_conditions;
+// Whether listings carry permissions. Permissions are fetched with one pair of queries per
+// collection (or per tree with --bulk) rather than per entry.
+static bool list_acls = false;
+// Users and groups keyed by id, used to name the bearers of permissions. Only the bearers of
+// listed permissions are looked up. The cache is shared by the walker's threads.
+static std::unordered_map<std::string, acl_entry> users;
+static std::mutex users_mutex;
+
+using collection_walker = utils::collection_walker<ix::client_connection, tree_entry>;
+
+// Every collection and data object under a collection, fetched with a handful of paginated
+// queries rather than one or more queries per collection. Entries live in a single array,
+// sorted so that the contents of each collection form a contiguous range.
+class bulk_listing
+{
+  public:
+    bulk_listing(ix::client_connection& conn, const fs::path& root, bool include_data_objects)
+    {
+        auto* comm = static_cast<rcComm_t*>(conn);
+        const auto root_name = root.string();
+        const auto prefix = ("/" == root_name) ? root_name : root_name + '/';
+
+        // LIKE treats any '_' in the prefix as a wildcard, so every row is also checked
+        // against the prefix.
+        const auto in_tree = [&](const std::string& p) { return p == root_name || p.starts_with(prefix); };
+
+        std::vector<std::pair<std::string, tree_entry>> rows;
+
+        for (auto&& row : irods::query<rcComm_t>{comm, fmt::format("select COLL_NAME where COLL_NAME like '{}%'", prefix)}) {
+            if (row[0] != root_name && in_tree(row[0])) {
+                rows.emplace_back(parent_collection(row[0]), tree_entry{row[0], true, 0});
+            }
+        }
+
+        if (include_data_objects) {
+            const auto query_string =
+                fmt::format("select COLL_NAME, DATA_NAME, DATA_SIZE where COLL_NAME = '{}' || like '{}%'{}",
+                            root_name, prefix, data_name_conditions);
+            for (auto&& row : irods::query<rcComm_t>{comm, query_string}) {
+                if (in_tree(row[0])) {
+                    rows.emplace_back(row[0], tree_entry{fs::path{row[0]} / row[1], false, std::stoull(row[2])});
+                }
+            }
+        }
+
+        // Within a collection, sub-collections come first and entries are sorted by name. Each
+        // replica of a data object produces a row, so adjacent duplicates are dropped.
+        const auto key = [](const auto& r) {
+            return std::make_tuple(std::cref(r.first), r.second.is_data_object(), r.second.path().string());
+        };
+        std::sort(std::begin(rows), std::end(rows), [&key](const auto& a, const auto& b) { return key(a) < key(b); });
+        rows.erase(std::unique(std::begin(rows), std::end(rows), [&key](const auto& a, const auto& b) { return key(a) == key(b); }),
+                   std::end(rows));
+
+        entries_.reserve(rows.size());
+        for (auto& [parent, entry] : rows) {
+            auto [it, inserted] = contents_.try_emplace(parent, entries_.size(), entries_.size());
+            ++it->second.second;
+            entries_.push_back(std::move(entry));
+        }
+
+        if (list_acls) {
+            auto acls = query_acls(conn,
+                                   fmt::format("COLL_NAME = '{}' || like '{}%'", root_name, prefix),
+                                   fmt::format("COLL_NAME like '{}%'", prefix));
+            for (auto& e : entries_) {
+                e.attach_acl(acls);
+            }
+        }
+    }
+
+    auto visit(const fs::path& collection, const entry_visitor& visit) const -> void
+    {
+        if (const auto it = contents_.find(collection.string()); it != std::end(contents_)) {
+            for (auto i = it->second.first; i < it->second.second; ++i) {
+                visit(entries_[i]);
+            }
+        }
+    }
+
+  private:
+    std::vector<tree_entry> entries_;
+    // Maps a collection to the range of entries_ holding its contents.
+    std::unordered_map<std::string, std::pair<std::size_t, std::size_t>> contents_;
+}; // class bulk_listing
 
 
 int main(int argc, char** argv){
@@ -61,9 +232,7 @@ int main(int argc, char** argv){
         ("collections-only,c", po::bool_switch(), "Only list collections")
         ("fullpath,f", po::bool_switch(), "print the full path of each item listed")
         ("depth,L", po::value<int>()->default_value(1000), "Limit the depth of the listing.")
-        //This does not function because the ownership variable is initialized to the
-        //original uploader of the data_object
-        //        ("owner,o", po::bool_switch(), "Display the owner along with the collection")
+        ("owner,o", po::bool_switch(), "Display the owners of each collection and data object")
         ("pattern,P", po::value<std::string>(), "Filter files by a filename glob")
         ("pattern-regex,p", po::value<std::string>(), "Filter files by a regexp")
         ("size,s", po::bool_switch(),"Display the size of each data object")
@@ -72,10 +241,13 @@ int main(int argc, char** argv){
         ("regex-extended-syntax,x", po::bool_switch(), "Regular expressions use extended syntax.")
         ("classify,F", po::bool_switch(), "Display a / at the end of listings of collections")
         ("indent", po::value<unsigned int>()->default_value(2), "The number of spaces each level of nested collection adds.")
-        // Currently this does not work because the object_status is not initialized with the necessary information to
-        // display this properly.
-        //        ("acl,A", po::bool_switch(), "Print the access control information for each object")
+        ("acl,A", po::bool_switch(), "Print the access control information for each object")
         ("json,J", po::bool_switch(), "Produce json instead of a human readable output")
+        ("ndjson", po::bool_switch(), "Produce one json object per line instead of a human readable output")
+        ("parallel", po::value<int>()->default_value(1), "The number of connections used to list collections")
+        ("bulk,b", po::bool_switch(), "Fetch the whole tree with a few queries before rendering it")
+        ("summarize", po::bool_switch(), "Print the recursive size and data object count of each collection")
+        ("max-depth", po::value<int>(), "Limit the depth of collections reported by --summarize")
         ("color,C", po::bool_switch(), "Print in color (requires ansi terminal)");
     try{
         po::variables_map vm;
@@ -113,6 +285,54 @@ int main(int argc, char** argv){
             exclude_matcher = vm["ignore"].as<std::string>();
         }
 
+        // Glob patterns that can be expressed with LIKE are evaluated by the catalog. Entries
+        // are still matched on the client, which also covers regular expressions and globs
+        // that have no LIKE equivalent.
+        bool client_side_matching = false;
+        if (const auto* glob = std::get_if<std::string>(&matcher); glob && glob_to_like(*glob)) {
+            data_name_conditions += fmt::format(" and DATA_NAME like '{}'", *glob_to_like(*glob));
+        }
+        else {
+            client_side_matching = contains_pattern(matcher);
+        }
+        if (const auto* glob = std::get_if<std::string>(&exclude_matcher); glob && glob_to_like(*glob)) {
+            data_name_conditions += fmt::format(" and DATA_NAME not like '{}'", *glob_to_like(*glob));
+        }
+        else {
+            client_side_matching = client_side_matching || contains_pattern(exclude_matcher);
+        }
+
+        if (vm["summarize"].as<bool>()) {
+            // The sizes are computed by the catalog, so every filter must be evaluated there.
+            if (client_side_matching) {
+                std::cerr << "Error: --summarize only supports glob patterns using the '*' and '?' wildcards.\n";
+                return 1;
+            }
+            if (vm.count("max-depth") && vm["max-depth"].as<int>() < 0) {
+                std::cerr << "Error: Invalid maximum depth.\n";
+                return 1;
+            }
+        }
+        else if (vm.count("max-depth")) {
+            std::cerr << "Error: --max-depth requires --summarize.\n";
+            return 1;
+        }
+
+        if (vm["json"].as<bool>() && vm["ndjson"].as<bool>()) {
+            std::cerr << "Incompatible options: --json and --ndjson cannot be used together\n";
+            exit(2);
+        }
+
+        const auto n_connections = vm["parallel"].as<int>();
+        if (n_connections < 1 || n_connections > utils::max_connections) {
+            std::cerr << "Error: Invalid number of connections (expected 1 to " << utils::max_connections << ").\n";
+            return 1;
+        }
+        if (n_connections > 1 && vm["bulk"].as<bool>()) {
+            std::cerr << "Incompatible options: --parallel and --bulk cannot be used together\n";
+            exit(2);
+        }
+
         if (getRodsEnv(&env) < 0) {
             std::cerr << "Error: Could not get iRODS environment.\n";
             return 1;
@@ -127,18 +347,86 @@ int main(int argc, char** argv){
             return 1;
         }
 
-        if (vm["json"].as<bool>()) {
-            auto value = get_json(path, vm, conn, vm["depth"].as<int>() );
-            json::json top;
-            top.push_back(value);
-            json::json report = {{"type","report"}, {"collections",collections},{"data_objects",objects}};
+        if (vm["summarize"].as<bool>()) {
+            // Quotes cannot be escaped in GenQuery.
+            if (path.string().find('\'') != std::string::npos) {
+                std::cerr << "Error: --summarize does not support collections whose names contain a single quote.\n";
+                return 1;
+            }
+            print_disk_usage(conn, path, vm);
+            return 0;
+        }
+
+        list_acls = vm["acl"].as<bool>() || vm["owner"].as<bool>();
+
+        // The human readable output skips collections the user cannot read, while the
+        // JSON output reports them as errors.
+        const auto json_output = vm["json"].as<bool>() || vm["ndjson"].as<bool>();
+        const auto options = json_output ? fs::client::collection_options::none
+                                         : fs::client::collection_options::skip_permission_denied;
+
+        // Entries are visited while the collection is being iterated, so memory use does
+        // not grow with the size of the tree.
+        collection_lister lister = [&conn, options](const fs::path& p, int, const entry_visitor& visit) {
+            list_collection(conn, p, options, visit);
+        };
+
+        std::optional<bulk_listing> bulk;
 
-            if (vm["size"].as<bool>()) {
-                report["size"] = total_size;
+        if (vm["bulk"].as<bool>()) {
+            // Quotes cannot be escaped in GenQuery.
+            if (path.string().find('\'') != std::string::npos) {
+                std::cerr << "Error: --bulk does not support collections whose names contain a single quote.\n";
+                return 1;
             }
+            bulk.emplace(conn, path, !vm["collections-only"].as<bool>());
+            lister = [&bulk](const fs::path& p, int, const entry_visitor& visit) { bulk->visit(p, visit); };
+        }
+
+        // The main connection is used by the renderer, so only the remaining
+        // connections are handed to the walker.
+        std::vector<ix::client_connection> pool(n_connections - 1);
+        std::optional<collection_walker> walker;
+
+        if (n_connections > 1) {
+            walker.emplace(
+                conn,
+                pool,
+                std::vector<std::string>{path.string()},
+                vm["depth"].as<int>(),
+                [options](ix::client_connection& c, const std::string& p, const entry_visitor& visit) {
+                    list_collection(c, p, options, visit);
+                },
+                [](const tree_entry& e) -> std::optional<std::string> {
+                    if (e.is_collection()) {
+                        return e.path().string();
+                    }
+                    return std::nullopt;
+                });
+            // The renderers visit sub-collections from within the visitor, so the
+            // listings are taken whole rather than streamed.
+            lister = [&walker](const fs::path& p, int depth, const entry_visitor& visit) {
+                for (const auto& e : walker->take(p.string(), depth)) {
+                    visit(e);
+                }
+            };
+        }
 
-            top.push_back(report);
-            std::cout << top.dump(2) << "\n";
+        // The permissions of the root collection are not part of any listing.
+        tree_entry root{path, true, 0};
+        if (json_output && list_acls && path.string().find('\'') == std::string::npos) {
+            auto acls = query_acls(conn, "", fmt::format("COLL_NAME = '{}'", path.string()));
+            root.attach_acl(acls);
+        }
+
+        if (vm["json"].as<bool>()) {
+            print_json(root, vm, lister);
+        }
+        else if (vm["ndjson"].as<bool>()) {
+            print_ndjson(root, vm, lister);
+        }
+        else if (walker || bulk || !data_name_conditions.empty() || list_acls) {
+            print_tree(path, vm, lister);
         }
         else {
             print_dir(path, vm, conn);
@@ -204,7 +492,7 @@ auto flexible_match(const std::string& obj_name, const pattern_matcher& pattern_
 }
 
 // Convenience function to wrap the logic for matching/ignoring.
-auto object_matches(const fs::client::collection_entry& entry) -> bool {
+auto object_matches(const tree_entry& entry) -> bool {
     const auto obj_name = entry.path().object_name().string();
 
     // consider --ignore* and --pattern* as logically AND'ed together
@@ -212,16 +500,14 @@ auto object_matches(const fs::client::collection_entry& entry) -> bool {
             (!contains_pattern(matcher) || flexible_match(obj_name, matcher)));
 }
 
-// Collection iterators don't populate the permissions field on the object status at this time.
-// If that should change this may still be useful.
-auto print_acl(const fs::client::collection_entry& e, const po::variables_map& vm){
+// Collection iterators don't populate the permissions field on the object status, so
+// permissions are attached to entries from catalog queries instead.
+auto print_acl(const tree_entry& e, const po::variables_map& vm){
     std::vector<std::string> elements;
     size_t size = 0;
-    auto status = e.status();
-    auto permissions = status.permissions();
-    for(const auto& perm: permissions){
+    for(const auto& perm: e.acl()){
         elements.emplace_back(fmt::format("{}#{}:{} - {}",perm.name, perm.zone,
-                                          permission_type_string(perm.prms),
+                                          perm.access_level,
                                           perm.type));
         size += elements.back().size();
     }
@@ -233,17 +519,18 @@ auto print_acl(const fs::client::collection_entry& e, const po::variables_map& v
     std::cout <<" - ACL: " << val;
 }
 
-auto directory_depth(const fs::path& origin, const fs::path& descendant) -> int{
-    int depth = 0;
-    auto d = descendant;
-    while( origin != d ) {
-        d = d.parent_path();
-        depth++;
+// Returns the names of the users and groups holding own permission, separated by commas.
+auto owners(const tree_entry& e) -> std::string {
+    std::string names;
+    for (const auto& perm : e.acl()) {
+        if ("own" == perm.access_level) {
+            names += names.empty() ? perm.name : "," + perm.name;
+        }
     }
-    return depth;
+    return names;
 }
 
-auto print_entry(const fs::client::collection_entry& e, const po::variables_map& vm, int depth){
+auto print_entry(const tree_entry& e, const po::variables_map& vm, int depth){
     fmt::print("{:{}}","",depth * vm["indent"].as<unsigned int>());
     auto disp = e.path();
     if( !vm["fullpath"].as<bool>() ){
@@ -262,33 +549,33 @@ auto print_entry(const fs::client::collection_entry& e, const po::variables_map&
                    static_cast<std::string>(disp),
                    suffix);
     }
-    if ( vm.count("owner") && !e.owner().empty() ) {
-        if( !vm["color"].as<bool>() ) {
-            fmt::print(": Owned by {}",e.owner());
-        } else {
-            fmt::print(fmt::fg(fmt::color::white), "{}", ": Owned By ");
-            fmt::print(fmt::fg(e.owner() == env.rodsUserName ? fmt::color::green : fmt::color::red), "{}", e.owner());
+    if ( vm["owner"].as<bool>() ) {
+        if( const auto owner = owners(e); !owner.empty() ) {
+            if( !vm["color"].as<bool>() ) {
+                fmt::print(": Owned by {}",owner);
+            } else {
+                const auto owned_by_user = std::any_of(std::begin(e.acl()), std::end(e.acl()), [](const auto& perm) {
+                    return "own" == perm.access_level && perm.name == env.rodsUserName;
+                });
+                fmt::print(fmt::fg(fmt::color::white), "{}", ": Owned By ");
+                fmt::print(fmt::fg(owned_by_user ? fmt::color::green : fmt::color::red), "{}", owner);
+            }
         }
     }
     if( e.is_data_object() && vm["size"].as<bool>() ) {
         fmt::print(" {} bytes", e.data_size());
     }
-    if(vm.count("acl")){
-        //        print_acl(e,vm);
+    if(vm["acl"].as<bool>()){
+        print_acl(e,vm);
     }
     std::cout << "\n";
 }
 
-auto print_dir(const fs::path& path,
-               const po::variables_map& vm,
-               irods::experimental::client_connection& conn) -> void {
-    auto fsiter=fs::client::recursive_collection_iterator{conn,path,fs::client::collection_options::skip_permission_denied};
-    const int max_depth = vm["depth"].as<int>();
+auto print_root(const fs::path& path, const po::variables_map& vm) -> void {
     const bool fullpath = vm["fullpath"].as<bool>();
     const bool classify = vm["classify"].as<bool>();
     const char* suffix = (classify || path.object_name().string().empty())?"/":"";
 
-    std::uintmax_t total_size = 0;
     if( vm["color"].as<bool>() ) {
         fmt::print(fmt::fg(directory_color),"{}{}\n",
                    fullpath?path.c_str():path.object_name().c_str(), suffix);
@@ -296,30 +583,83 @@ auto print_dir(const fs::path& path,
         fmt::print("{}{}\n",
                    fullpath?path.c_str(): path.object_name().c_str(), suffix);
     }
+}
+
+auto print_summary(const po::variables_map& vm, std::uintmax_t total_size) -> void {
+    if( vm["size"].as<bool>() ){
+        fmt::print("Found {} collections and {} data objects, taking up {} bytes total\n",
+                   collections, objects,
+                   total_size);
+    } else {
+        fmt::print("Found {} collections and {} data objects\n",
+                   collections, objects);
+    }
+}
+
+auto print_dir(const fs::path& path,
+               const po::variables_map& vm,
+               irods::experimental::client_connection& conn) -> void {
+    const int max_depth = vm["depth"].as<int>();
+    fs::client::recursive_collection_iterator fsiter;
+    if( max_depth > 0 ) {
+        fsiter=fs::client::recursive_collection_iterator{conn,path,fs::client::collection_options::skip_permission_denied};
+    }
+
+    std::uintmax_t total_size = 0;
+    print_root(path, vm);
     //    unsigned int objects = 0, collections = 0;
-    for(auto &&iter:fsiter){
-        auto current_depth = directory_depth(path,iter.path());
+    // The depth reported by the iterator starts at zero for the entries of the root collection.
+    // Collections at the depth limit are not descended into, so nothing beyond the limit is
+    // ever queried.
+    const fs::client::recursive_collection_iterator end;
+    for( ; fsiter != end; ++fsiter ){
+        const tree_entry iter = *fsiter;
+        const auto current_depth = fsiter.depth() + 1;
         auto is_dir = iter.is_collection();
+        if( is_dir && current_depth >= max_depth ) {
+            fsiter.disable_recursion_pending();
+        }
         if( !is_dir ){
             if( vm["collections-only"].as<bool>() || !object_matches( iter ) ) {
                 continue;
             }
         }
-        if( current_depth  > max_depth ){
-            continue;
-        }
         (is_dir ? collections : objects)++;
         total_size += iter.data_size();
         print_entry(iter, vm, current_depth);
     }
-    if( vm["size"].as<bool>() ){
-        fmt::print("Found {} collections and {} data objects, taking up {} bytes total\n",
-                   collections, objects,
-                   total_size);
-    } else {
-        fmt::print("Found {} collections and {} data objects\n",
-                   collections, objects);
+    print_summary(vm, total_size);
+}
+
+// Renders the same output as print_dir from collection listings, such as those produced by
+// a collection_walker.
+auto print_tree(const fs::path& path,
+                const po::variables_map& vm,
+                const collection_lister& lister) -> void {
+    const int max_depth = vm["depth"].as<int>();
+    const bool collections_only = vm["collections-only"].as<bool>();
+    std::uintmax_t total_size = 0;
+
+    const auto print_contents = [&](const auto& self, const fs::path& collection, int depth) -> void {
+        lister(collection, depth, [&](const tree_entry& e) {
+            const auto is_dir = e.is_collection();
+            if( !is_dir && (collections_only || !object_matches(e)) ) {
+                return;
+            }
+            (is_dir ? collections : objects)++;
+            total_size += e.data_size();
+            print_entry(e, vm, depth + 1);
+            if( is_dir && depth + 1 < max_depth ) {
+                self(self, e.path(), depth + 1);
+            }
+        });
+    };
+
+    print_root(path, vm);
+    if( max_depth > 0 ) {
+        print_contents(print_contents, path, 0);
     }
+    print_summary(vm, total_size);
 }
 
 auto correct_path(const po::variables_map& pm, rodsEnv& env) -> fs::path {
@@ -347,9 +687,17 @@ Usage: itree [OPTION]... COLLECTION
 
 When using this command, avoid listing very large collections. Failing to
 follow this advice can result in unexpected failures. Consider listing smaller
-collections or using --depth to limit the number of collections traversed.
+collections, using --depth to limit the number of collections traversed, or
+using --parallel to list collections over several connections.
 
 Options:
+  -A, --acl       Print the access control list of each collection and data
+                  object.
+  -b, --bulk      Fetch every collection and data object in the tree with a few
+                  paginated queries, then render the tree. Within a collection,
+                  sub-collections are listed first and entries are sorted by
+                  name. --depth only limits what is printed. Cannot be used
+                  with --parallel.
   -c, --collections-only
                   Only list collections.
   -C, --color     Print in color (requires ANSI terminal).
@@ -359,18 +707,43 @@ Options:
   -i, --ignore-regex=PATTERN
                   Ignore data objects matching a regular expression.
   -I, --ignore=PATTERN
-                  Ignore data objects matching a file glob pattern.
+                  Ignore data objects matching a file glob pattern. Patterns
+                  using only '*' and '?' wildcards are evaluated by the
+                  catalog.
       --indent=INTEGER
                   The number of spaces used for indenting nested collections.
                   (defaults to 2).
-  -J, --json      Print collection tree as JSON.
+  -J, --json      Print collection tree as JSON. The document is printed while
+                  the tree is traversed.
+      --ndjson    Print one JSON object per line for each collection and data
+                  object in the tree (including its depth), followed by a
+                  report object.
   -L, --depth=INTEGER
                   Limit the depth of the listing (defaults to 1000).
+      --parallel=INTEGER
+                  The number of connections used to list collections
+                  concurrently (defaults to 1, at most 64). Output is
+                  identical to a sequential listing.
+  -o, --owner     Print the users and groups owning each collection and data
+                  object.
   -p, --pattern-regex=PATTERN
                   Filter data objects by a regular expression.
   -P, --pattern=PATTERN
-                  Filter data objects by a file glob pattern.
+                  Filter data objects by a file glob pattern. Patterns using
+                  only '*' and '?' wildcards are evaluated by the catalog.
   -s, --size      Display the size of each data object.
+      --summarize Print the recursive size in bytes, the recursive number of
+                  data objects, and the logical path of each collection, one
+                  per line, with sub-collections before their parent (like
+                  du). Each data object is counted once and contributes the
+                  size of its largest replica. Glob patterns using only '*'
+                  and '?' restrict the data objects counted. With --json, an
+                  array of objects is printed instead; with --ndjson, one
+                  object per line.
+      --max-depth=INTEGER
+                  Only report collections at most this many levels below
+                  COLLECTION with --summarize. All collections are still
+                  counted.
   -x, --regex-extended-syntax
                   Enable extended syntax for regular expressions.
 )_");
@@ -378,71 +751,507 @@ Options:
     printReleaseInfo("itree");
 }
 
-auto contents_size(const json::json& value) -> std::uintmax_t {
-    std::uintmax_t total = 0;
-    for(const auto& child : value["contents"]) {
-        total += child["size"].get<std::uintmax_t>();
+// Translates a glob into a LIKE pattern. Globs using bracket expressions or escapes, or
+// containing characters that are special to LIKE or GenQuery, have no translation. This
+// includes '_', which LIKE would treat as a wildcard and GenQuery cannot escape, so such
+// globs fall back to listing the whole collection and matching on the client.
+auto glob_to_like(const std::string& glob) -> std::optional<std::string> {
+    std::string like;
+    like.reserve(glob.size());
+    for (const auto c : glob) {
+        switch (c) {
+            case '*': like += '%'; break;
+            case '?': like += '_'; break;
+            case '[':
+            case '\\':
+            case '%':
+            case '_':
+            case '\'':
+                return std::nullopt;
+            default: like += c; break;
+        }
     }
-    return total;
+    return like;
 }
 
-auto get_json(const fs::path& path, const po::variables_map& vm, ix::client_connection& conn, unsigned int depth ) -> json::json  {
-    auto fsiter = fs::client::collection_iterator(conn, path);
-    json::json value;
-    value["type"] = "collection";
-    if( vm["fullpath"].as<bool>() || path.object_name().string().empty() ) {
-        value["name"] = path;
-    } else {
-        value["name"] = path.object_name();
-    }
-    value["contents"] = json::json::value_t::array;
-    if( depth == 0 ) {
-        return value;
-    }
-    for(const auto& object: fsiter) {
-        if( object.is_collection() ) {
-            json::json sub_coll;
-            sub_coll = get_json(object.path(), vm, conn, depth - 1);
-            value["contents"].emplace_back(std::move(sub_coll));
-            collections++;
-        } else {
-            if(  vm["collections-only"].as<bool>() || !object_matches(object) ) {
-                continue;
-            }
-            json::json data_object;
-            if( vm["fullpath"].as<bool>() ){
-                data_object["name"] = object.path();
-            } else {
-                data_object["name"] = object.path().object_name().string();
-            }
-            data_object["type"] = "data_object";
+// Lists a collection with catalog queries, applying data_name_conditions. Rows arrive in
+// database order, so entries are sorted the same way as the iterator and --bulk list them:
+// sub-collections first, each group sorted by name.
+auto query_collection(ix::client_connection& conn, const fs::path& path, const entry_visitor& visit) -> void {
+    auto* comm = static_cast<rcComm_t*>(conn);
+    const auto coll_name = path.string();
 
-            if( vm["size"].as<bool>() ) {
-                data_object["size"] = object.data_size();
-            }
-            if( vm.count("acl") ) {
-                json::json permissions;
-                for ( auto& perm : object.status().permissions() ) {
-                    json::json permission;
-                    permission["bearer_name"] = perm.name;
-                    permission["zone"] = perm.zone;
-                    permission["access_level"] = permission_type_string(perm.prms);
-                    permission["type"] = perm.type;
-                    permissions.emplace_back(permission);
-                }
-                data_object["acl"]=permissions;
+    std::vector<std::string> sub_collections;
+    const auto coll_query = fmt::format("select COLL_NAME where COLL_PARENT_NAME = '{}'", coll_name);
+    for (auto&& row : irods::query<rcComm_t>{comm, coll_query}) {
+        // The root collection is its own parent.
+        if (row[0] != coll_name) {
+            sub_collections.push_back(row[0]);
+        }
+    }
+    std::sort(std::begin(sub_collections), std::end(sub_collections));
+    for (const auto& name : sub_collections) {
+        visit(tree_entry{name, true, 0});
+    }
+
+    // Each replica produces a row, but a data object is listed once.
+    std::map<std::string, std::uintmax_t> data_objects;
+    const auto query_string = fmt::format("select DATA_NAME, DATA_SIZE where COLL_NAME = '{}'{}",
+                                          coll_name, data_name_conditions);
+    for (auto&& row : irods::query<rcComm_t>{comm, query_string}) {
+        data_objects.try_emplace(row[0], std::stoull(row[1]));
+    }
+    for (const auto& [name, size] : data_objects) {
+        visit(tree_entry{path / name, false, size});
+    }
+}
+
+auto parent_collection(const std::string& path) -> std::string {
+    const auto pos = path.rfind('/');
+    return 0 == pos ? "/" : path.substr(0, pos);
+}
+
+struct collection_usage {
+    std::uintmax_t size = 0;
+    std::uintmax_t data_objects = 0;
+};
+
+// Prints the recursive size and data object count of each collection in the tree, children
+// before their parent as du does. Each replica has its own catalog row, so a SUM/COUNT over
+// the rows would count data objects once per replica. Instead, the catalog groups the rows by
+// data object and returns one size per data object (the largest of its replicas), which only
+// transfers an id and a size for each data object.
+auto print_disk_usage(ix::client_connection& conn, const fs::path& root, const po::variables_map& vm) -> void {
+    auto* comm = static_cast<rcComm_t*>(conn);
+    const auto root_name = root.string();
+    const auto prefix = ("/" == root_name) ? root_name : root_name + '/';
+    const auto max_depth = vm.count("max-depth") ? vm["max-depth"].as<int>() : std::numeric_limits<int>::max();
+
+    // LIKE treats any '_' in the prefix as a wildcard, so every row is also checked against the prefix.
+    const auto in_tree = [&](const std::string& p) { return p == root_name || p.starts_with(prefix); };
+
+    std::unordered_map<std::string, collection_usage> usage{{root_name, {}}};
+    std::unordered_map<std::string, std::vector<std::string>> children;
+
+    for (auto&& row : irods::query<rcComm_t>{comm, fmt::format("select COLL_NAME where COLL_NAME like '{}%'", prefix)}) {
+        if (row[0] != root_name && in_tree(row[0])) {
+            usage.try_emplace(row[0]);
+            children[parent_collection(row[0])].push_back(row[0]);
+        }
+    }
+
+    const auto query_string =
+        fmt::format("select COLL_NAME, DATA_ID, max(DATA_SIZE) where COLL_NAME = '{}' || like '{}%'{}",
+                    root_name, prefix, data_name_conditions);
+    for (auto&& row : irods::query<rcComm_t>{comm, query_string}) {
+        if (const auto it = usage.find(row[0]); it != std::end(usage) && !row[2].empty()) {
+            it->second.size += std::stoull(row[2]);
+            ++it->second.data_objects;
+        }
+    }
+
+    auto report = json::json::array();
+    const auto emit = [&vm, &report](const std::string& name, int depth, const collection_usage& u) {
+        const json::json value{{"data_objects", u.data_objects}, {"depth", depth}, {"name", name}, {"size", u.size}};
+        if (vm["json"].as<bool>()) {
+            report.push_back(value);
+        }
+        else if (vm["ndjson"].as<bool>()) {
+            std::cout << value.dump() << '\n';
+        }
+        else {
+            fmt::print("{}\t{}\t{}\n", u.size, u.data_objects, name);
+        }
+    };
+
+    const auto rollup = [&](const auto& self, const std::string& name, int depth) -> collection_usage {
+        auto total = usage[name];
+        if (auto it = children.find(name); it != std::end(children)) {
+            std::sort(std::begin(it->second), std::end(it->second));
+            for (const auto& child : it->second) {
+                const auto u = self(self, child, depth + 1);
+                total.size += u.size;
+                total.data_objects += u.data_objects;
             }
-            value["contents"].emplace_back( std::move(data_object) );
-            total_size += object.data_size();
-            objects++;
         }
+        if (depth <= max_depth) {
+            emit(name, depth, total);
+        }
+        return total;
+    };
+
+    rollup(rollup, root_name, 0);
+
+    if (vm["json"].as<bool>()) {
+        std::cout << report.dump(2) << '\n';
+    }
+}
+
+// Records the user or group each id refers to, for the ids not looked up yet. Ids are looked
+// up in batches to keep the number of queries low without exceeding the length of a condition.
+auto load_users(ix::client_connection& conn, std::vector<std::string> ids) -> void {
+    constexpr std::size_t batch_size = 32;
+
+    std::sort(std::begin(ids), std::end(ids));
+    ids.erase(std::unique(std::begin(ids), std::end(ids)), std::end(ids));
+    {
+        std::scoped_lock lock{users_mutex};
+        std::erase_if(ids, [](const auto& id) { return users.count(id) > 0; });
+    }
+
+    for (std::size_t i = 0; i < ids.size(); i += batch_size) {
+        std::string id_list;
+        for (auto j = i; j < std::min(ids.size(), i + batch_size); ++j) {
+            id_list += fmt::format("{}'{}'", id_list.empty() ? "" : ", ", ids[j]);
+        }
+        const auto query_string =
+            fmt::format("select USER_ID, USER_NAME, USER_ZONE, USER_TYPE where USER_ID in ({})", id_list);
+        for (auto&& row : irods::query<rcComm_t>{static_cast<rcComm_t*>(conn), query_string}) {
+            std::scoped_lock lock{users_mutex};
+            users[row[0]] = acl_entry{row[1], row[2], "", row[3]};
+        }
+    }
+}
+
+// Catalog access names use spaces in some versions and differ from the names the
+// filesystem library reports for reading and writing.
+auto access_level_name(std::string name) -> std::string {
+    std::replace(std::begin(name), std::end(name), ' ', '_');
+    if ("read_object" == name) {
+        return "read";
+    }
+    if ("modify_object" == name) {
+        return "write";
+    }
+    return name;
+}
+
+// Fetches the permissions of the data objects and collections matching the conditions with
+// one query each, however many entries they cover. An empty condition skips its query.
+auto query_acls(ix::client_connection& conn, const std::string& data_condition, const std::string& coll_condition)
+    -> acl_map {
+    auto* comm = static_cast<rcComm_t*>(conn);
+
+    // Grants are collected first so that their bearers can be looked up together.
+    struct grant {
+        std::string path;
+        std::string access;
+        std::string user_id;
+    };
+    std::vector<grant> grants;
+
+    if (!data_condition.empty()) {
+        const auto query_string =
+            "select COLL_NAME, DATA_NAME, DATA_ACCESS_NAME, DATA_ACCESS_USER_ID where " + data_condition;
+        for (auto&& row : irods::query<rcComm_t>{comm, query_string}) {
+            grants.push_back({(fs::path{row[0]} / row[1]).string(), row[2], row[3]});
+        }
+    }
+    if (!coll_condition.empty()) {
+        const auto query_string = "select COLL_NAME, COLL_ACCESS_NAME, COLL_ACCESS_USER_ID where " + coll_condition;
+        for (auto&& row : irods::query<rcComm_t>{comm, query_string}) {
+            grants.push_back({row[0], row[1], row[2]});
+        }
+    }
+
+    std::vector<std::string> ids;
+    ids.reserve(grants.size());
+    for (const auto& g : grants) {
+        ids.push_back(g.user_id);
+    }
+    load_users(conn, std::move(ids));
+
+    acl_map acls;
+    {
+        std::scoped_lock lock{users_mutex};
+        for (auto& g : grants) {
+            const auto it = users.find(g.user_id);
+            auto perm = (it != std::end(users)) ? it->second : acl_entry{g.user_id, "", "", ""};
+            perm.access_level = access_level_name(g.access);
+            acls[g.path].push_back(std::move(perm));
+        }
+    }
+
+    for (auto& [path, perms] : acls) {
+        std::sort(std::begin(perms), std::end(perms), [](const auto& a, const auto& b) {
+            return std::tie(a.name, a.zone) < std::tie(b.name, b.zone);
+        });
+    }
+
+    return acls;
+}
+
+auto list_entries(ix::client_connection& conn,
+                  const fs::path& path,
+                  fs::client::collection_options options,
+                  const entry_visitor& visit) -> void {
+    // Quotes cannot be escaped in GenQuery, so such collections are always iterated.
+    if( !data_name_conditions.empty() && path.string().find('\'') == std::string::npos ) {
+        query_collection(conn, path, visit);
+        return;
+    }
+    for (auto&& e : fs::client::collection_iterator{conn, path, options}) {
+        visit(e);
+    }
+}
+
+auto list_collection(ix::client_connection& conn,
+                     const fs::path& path,
+                     fs::client::collection_options options,
+                     const entry_visitor& visit) -> void {
+    if( !list_acls || path.string().find('\'') != std::string::npos ) {
+        list_entries(conn, path, options, visit);
+        return;
+    }
+
+    // The permissions of everything in the collection are fetched up front and joined to
+    // the entries as they are listed.
+    auto acls = query_acls(conn,
+                           fmt::format("COLL_NAME = '{}'", path.string()),
+                           fmt::format("COLL_PARENT_NAME = '{}'", path.string()));
+    list_entries(conn, path, options, [&acls, &visit](const tree_entry& e) {
+        auto entry = e;
+        entry.attach_acl(acls);
+        visit(entry);
+    });
+}
+
+auto entry_name(const fs::path& path, const po::variables_map& vm) -> std::string {
+    if( vm["fullpath"].as<bool>() || path.object_name().string().empty() ) {
+        return path.string();
     }
+    return path.object_name().string();
+}
+
+auto acl_json(const tree_entry& entry) -> json::json {
+    json::json permissions;
+    for ( const auto& perm : entry.acl() ) {
+        json::json permission;
+        permission["bearer_name"] = perm.name;
+        permission["zone"] = perm.zone;
+        permission["access_level"] = perm.access_level;
+        permission["type"] = perm.type;
+        permissions.emplace_back(permission);
+    }
+    return permissions;
+}
+
+auto data_object_json(const tree_entry& object, const po::variables_map& vm) -> json::json {
+    json::json data_object;
+    data_object["name"] = entry_name(object.path(), vm);
+    data_object["type"] = "data_object";
+
     if( vm["size"].as<bool>() ) {
-        value["size"] = contents_size(value);
+        data_object["size"] = object.data_size();
+    }
+    if( vm["owner"].as<bool>() ) {
+        data_object["owner"] = owners(object);
+    }
+    if( vm["acl"].as<bool>() ) {
+        data_object["acl"] = acl_json(object);
+    }
+    return data_object;
+}
+
+// The members of a collection other than its contents and size.
+auto collection_json(const tree_entry& collection, const po::variables_map& vm) -> json::json {
+    json::json value{{"name", entry_name(collection.path(), vm)}, {"type", "collection"}};
+
+    if( vm["owner"].as<bool>() ) {
+        value["owner"] = owners(collection);
+    }
+    if( vm["acl"].as<bool>() ) {
+        value["acl"] = acl_json(collection);
     }
     return value;
 }
 
+auto report_json(const po::variables_map& vm) -> json::json {
+    json::json report = {{"type","report"}, {"collections",collections},{"data_objects",objects}};
+
+    if (vm["size"].as<bool>()) {
+        report["size"] = total_size;
+    }
+
+    return report;
+}
+
+// Starts the next element of an array whose elements are indented to the given level.
+auto begin_element(bool& first, int level) -> void {
+    std::cout << (first ? "\n" : ",\n") << std::string(2 * level, ' ');
+    first = false;
+}
+
+// Prints a value nested at the given level exactly as json::dump(2) would.
+auto print_nested(const json::json& value, int level) -> void {
+    const auto indent = "\n" + std::string(2 * level, ' ');
+    const auto text = value.dump(2);
+    std::string::size_type start = 0;
+    for (auto end = text.find('\n'); end != std::string::npos; start = end + 1, end = text.find('\n', start)) {
+        std::cout.write(text.data() + start, end - start) << indent;
+    }
+    std::cout << text.substr(start);
+}
+
+// Thrown once a collection object has been closed after a failure in one of its descendants,
+// so that every enclosing object is closed as the exception propagates.
+struct json_listing_aborted
+{
+    std::exception_ptr error;
+};
+
+// Prints a collection object at the given level as its contents are listed. Members are
+// printed in the order json::dump uses (sorted by key), which places "contents" before
+// "size", so the size can be accumulated while streaming. Returns the size of the collection.
+// If listing fails, the object is still closed and carries an "error" member, so the output
+// remains valid json.
+auto print_json_collection(const tree_entry& collection,
+                           const po::variables_map& vm,
+                           const collection_lister& lister,
+                           int depth,
+                           int level) -> std::uintmax_t {
+    const auto& path = collection.path();
+    const auto max_depth = vm["depth"].as<int>();
+    const auto member_indent = ",\n" + std::string(2 * (level + 1), ' ');
+    const auto members = collection_json(collection, vm);
+    std::uintmax_t size = 0;
+    bool first = true;
+
+    std::cout << "{\n" << std::string(2 * (level + 1), ' ');
+    if( members.contains("acl") ) {
+        std::cout << "\"acl\": ";
+        print_nested(members["acl"], level + 1);
+        std::cout << member_indent.substr(1);
+    }
+    std::cout << "\"contents\": [";
+
+    std::optional<json_listing_aborted> aborted;
+    std::string error;
+
+    if( depth < max_depth ) {
+        try {
+            lister(path, depth, [&](const tree_entry& object) {
+                if( object.is_collection() ) {
+                    begin_element(first, level + 2);
+                    size += print_json_collection(object, vm, lister, depth + 1, level + 2);
+                    collections++;
+                } else {
+                    if(  vm["collections-only"].as<bool>() || !object_matches(object) ) {
+                        return;
+                    }
+                    begin_element(first, level + 2);
+                    print_nested(data_object_json(object, vm), level + 2);
+                    size += object.data_size();
+                    total_size += object.data_size();
+                    objects++;
+                }
+            });
+        }
+        catch (const json_listing_aborted& e) {
+            aborted = e;
+        }
+        catch (const irods::exception& e) {
+            aborted = json_listing_aborted{std::current_exception()};
+            error = e.client_display_what();
+        }
+        catch (const std::exception& e) {
+            aborted = json_listing_aborted{std::current_exception()};
+            error = e.what();
+        }
+    }
+
+    if( !first ) {
+        std::cout << "\n" << std::string(2 * (level + 1), ' ');
+    }
+    std::cout << "]";
+    if( !error.empty() ) {
+        std::cout << member_indent << "\"error\": " << json::json(error).dump();
+    }
+    std::cout << member_indent << "\"name\": " << members["name"].dump();
+    if( members.contains("owner") ) {
+        std::cout << member_indent << "\"owner\": " << members["owner"].dump();
+    }
+
+    // Collections beyond the depth limit, or which could not be listed completely, have no size.
+    if( vm["size"].as<bool>() && depth < max_depth && !aborted ) {
+        std::cout << member_indent << "\"size\": " << size;
+    }
+    std::cout << member_indent << "\"type\": \"collection\"\n" << std::string(2 * level, ' ') << "}";
+
+    if( aborted ) {
+        throw *aborted;
+    }
+
+    return size;
+}
+
+// Prints the tree as a json array holding the root collection followed by the report.
+// The output matches json::dump(2) of the whole document, but is produced without
+// holding the document in memory.
+auto print_json(const tree_entry& root, const po::variables_map& vm, const collection_lister& lister) -> void {
+    bool first = true;
+    std::cout << "[";
+    begin_element(first, 1);
+    try {
+        print_json_collection(root, vm, lister, 0, 1);
+    }
+    catch (const json_listing_aborted& e) {
+        // The report is omitted, as the counts are incomplete.
+        std::cout << "\n]\n";
+        std::rethrow_exception(e.error);
+    }
+    begin_element(first, 1);
+    print_nested(report_json(vm), 1);
+    std::cout << "\n]\n";
+}
+
+// Prints one json object per line for each entry in depth-first order, followed by the report.
+auto print_ndjson(const tree_entry& root, const po::variables_map& vm, const collection_lister& lister) -> void {
+    const auto max_depth = vm["depth"].as<int>();
+
+    const auto print_contents = [&](const auto& self, const fs::path& collection, int depth) -> void {
+        lister(collection, depth, [&](const tree_entry& object) {
+            if( object.is_collection() ) {
+                collections++;
+                auto value = collection_json(object, vm);
+                value["depth"] = depth + 1;
+                std::cout << value.dump() << '\n';
+                if( depth + 1 < max_depth ) {
+                    self(self, object.path(), depth + 1);
+                }
+            } else {
+                if(  vm["collections-only"].as<bool>() || !object_matches(object) ) {
+                    return;
+                }
+                auto value = data_object_json(object, vm);
+                value["depth"] = depth + 1;
+                std::cout << value.dump() << '\n';
+                total_size += object.data_size();
+                objects++;
+            }
+        });
+    };
+
+    auto value = collection_json(root, vm);
+    value["depth"] = 0;
+    std::cout << value.dump() << '\n';
+    if( max_depth > 0 ) {
+        // A failure ends the listing with an error object in place of the report.
+        try {
+            print_contents(print_contents, root.path(), 0);
+        }
+        catch (const irods::exception& e) {
+            std::cout << json::json{{"error", e.client_display_what()}}.dump() << '\n';
+            throw;
+        }
+        catch (const std::exception& e) {
+            std::cout << json::json{{"error", e.what()}}.dump() << '\n';
+            throw;
+        }
+    }
+    std::cout << report_json(vm).dump() << '\n';
+}
+
 auto contains_pattern(const pattern_matcher& pm) -> bool {
     return !std::holds_alternative<int>(pm);
 }
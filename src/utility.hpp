@@ -3,16 +3,25 @@
 
 #include <irods/authentication_plugin_framework.hpp>
 #include <irods/getRodsEnv.h>
+#include <irods/rodsClient.h>
 #include <irods/rodsDef.h>
 
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <optional>
+#include <string>
 #include <string_view>
 
 #include <nlohmann/json.hpp>
 
 namespace utils
 {
+    // The largest number of connections a command opens to the server for a single
+    // operation (e.g. with --parallel).
+    inline constexpr int max_connections = 64;
+
     inline auto set_ips_display_name(const std::string_view _display_name) -> void
     {
         // Setting this environment variable is required so that "ips" can display
@@ -29,6 +38,27 @@ namespace utils
         return ia::authenticate_client(*_comm, ctx);
     } // authenticate_client
 
+    // Opens and authenticates an additional connection to the server in _env, such as one of
+    // the connections used with --parallel. Errors are printed to stderr and nullptr returned.
+    inline auto connect_to_server(rodsEnv& _env, int _reconnect_flag = NO_RECONN) -> rcComm_t*
+    {
+        rErrMsg_t err_msg{};
+        auto* comm =
+            rcConnect(_env.rodsHost, _env.rodsPort, _env.rodsUserName, _env.rodsZone, _reconnect_flag, &err_msg);
+
+        if (!comm) {
+            return nullptr;
+        }
+
+        if (std::strcmp(_env.rodsUserName, PUBLIC_USER_NAME) != 0 && authenticate_client(comm, _env) != 0) {
+            print_error_stack_to_file(comm->rError, stderr);
+            rcDisconnect(comm);
+            return nullptr;
+        }
+
+        return comm;
+    } // connect_to_server
+
     inline auto option_specified(std::string_view _option, int argc, char** argv) -> bool
     {
         for (int arg = 0; arg < argc; ++arg) {
@@ -45,6 +75,39 @@ namespace utils
 
         return false;
     } // option_specified
+
+    // Returns the value of an option given as "--option VALUE" or "--option=VALUE", or an
+    // empty string if the value is missing. As with option_specified, the arguments are
+    // replaced so that parseCmdLineOpt ignores them.
+    inline auto option_value(std::string_view _option, int argc, char** argv) -> std::optional<std::string>
+    {
+        for (int arg = 0; arg < argc; ++arg) {
+            if (!argv[arg]) {
+                continue;
+            }
+
+            const std::string_view current = argv[arg];
+
+            if (_option == current) {
+                argv[arg] = "-Z";
+
+                if (arg + 1 < argc && argv[arg + 1]) {
+                    std::string value = argv[arg + 1];
+                    argv[arg + 1] = "-Z";
+                    return value;
+                }
+
+                return std::string{};
+            }
+
+            if (current.size() > _option.size() && current.starts_with(_option) && '=' == current[_option.size()]) {
+                argv[arg] = "-Z";
+                return std::string{current.substr(_option.size() + 1)};
+            }
+        }
+
+        return std::nullopt;
+    } // option_value
 } // namespace utils
 
 #endif // IRODS_ICOMMANDS_UTILITY_HPP